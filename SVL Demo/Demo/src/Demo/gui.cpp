@@ -3,6 +3,7 @@
 #include <SVL/common/ErrorHandler.h>
 #include <SVL/graphics/renderer.h>
 #include <SVL/graphics/tools.h>
+#include <SVL/graphics/upload.h>
 
 #include "external/imgui/imgui.h"
 #include "external/imgui/imgui_impl_vulkan.h"
@@ -42,7 +43,7 @@ MyGUI::MyGUI(const SVL::Window& window, GLFWwindow* glfw)
 : SVL::SecCommand(window.renderer()), window(window)
 {
 	create_descriptor_pool();
-	create_command_buffers(window.framebuffers()->size());
+	create_command_buffers(window.frames_in_flight());
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -57,7 +58,7 @@ MyGUI::MyGUI(const SVL::Window& window, GLFWwindow* glfw)
 	init_info.Device = vk_renderer.device();
 	init_info.QueueFamily = vk_renderer.graphics_family_index();
 	init_info.Queue = vk_renderer.queue();
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = vk_renderer.pipeline_cache();
 	init_info.DescriptorPool = vk_descriptor_pool;
 	init_info.Allocator = nullptr;
 	init_info.MinImageCount = window.image_count();
@@ -87,14 +88,14 @@ void MyGUI::update()
 {
 	destroy_command_buffers();
 
-	create_command_buffers(window.framebuffers()->size());
+	create_command_buffers(window.frames_in_flight());
 }
 
 void MyGUI::update_command_buffers(VkCommandBufferInheritanceInfo inheritance_info, uint32_t index)
 {
 	VkCommandBufferBeginInfo command_buffer_begin_info = {};
 	command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
 	command_buffer_begin_info.pInheritanceInfo = &inheritance_info;
 
 	ErrorCheck(vkBeginCommandBuffer(vk_command_buffers[index], &command_buffer_begin_info));
@@ -307,6 +308,8 @@ static SVL::Texture* draw_load_texture(GUIShareData& data, std::string id)
 
 void edit_image_channel(SVL::Renderer& renderer, VkCommandPool command_pool, SVL::ImageView& image, uint8_t* dc, unsigned offset)
 {
+	//the image may still be read by frames in flight
+	renderer.wait_for_device();
 	vkDestroyImageView(renderer.device(), image.view, nullptr);
 
 	VkMemoryRequirements mem_req;
@@ -322,15 +325,31 @@ void edit_image_channel(SVL::Renderer& renderer, VkCommandPool command_pool, SVL
 	void* da;
 	ErrorCheck(vkMapMemory(renderer.device(), buffer_memory, 0, mem_req.size, 0, &da));
 	uint8_t* dd = reinterpret_cast<uint8_t*>(da);
-	for (size_t i = 0; i < mem_req.size; i += 4)
+	//only level 0 was read back
+	VkDeviceSize level_size = (VkDeviceSize)image.extent.width * image.extent.height * 4;
+	for (size_t i = 0; i < level_size; i += 4)
 	{
 		dd[i + offset] = dc[i + offset];
 	}
-	vkUnmapMemory(renderer.device(), buffer_memory);
 
-	image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
-	image.copy_buffer_to_image(command_pool, buffer, VK_IMAGE_ASPECT_COLOR_BIT);
-	image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	if (SVL::UploadBatch::can_generate_mipmaps(renderer, image.format))
+	{
+		//the smaller levels still hold the old channel, rewrite level 0 and blit the rest from it
+		//every level is overwritten so the old contents are discarded
+		image.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		SVL::UploadBatch upload(renderer);
+		upload.transition_image_layout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		upload.copy_buffer_to_image(dd, level_size, image, VK_IMAGE_ASPECT_COLOR_BIT);
+		upload.generate_mipmaps(image, VK_IMAGE_ASPECT_COLOR_BIT);
+		renderer.uploads().wait(upload.submit());
+	}
+	else
+	{
+		image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		image.copy_buffer_to_image(command_pool, buffer, VK_IMAGE_ASPECT_COLOR_BIT);
+		image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	vkUnmapMemory(renderer.device(), buffer_memory);
 
 	//destroy buffer
 	vkFreeMemory(renderer.device(), buffer_memory, nullptr);
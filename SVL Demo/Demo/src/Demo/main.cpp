@@ -49,5 +49,6 @@ int main()
 		gui.draw(data);
 		window.draw();
 	}
+	renderer.wait_for_device();
 	return 0;
 }
\ No newline at end of file
@@ -9,19 +9,30 @@ struct PointLight
     vec4 params;
 };
 
-layout(set = 0, binding = 0) uniform UniformBufferObject {
-	mat4 model;
+layout(set = 0, binding = 0) uniform SceneUniforms {
 	mat4 view;
 	mat4 proj;
 	vec4 view_pos;
 	PointLight point_light[NR_POINT_LIGHTS];
-} ubo;
+} scene;
+
+layout(set = 2, binding = 0) uniform ObjectUniforms {
+	mat4 model;
+} object;
+
+//set by Layer3D, PushConstantTransform layers push the transform per draw
+layout(constant_id = 0) const bool PUSH_CONSTANT_TRANSFORM = false;
+layout(push_constant) uniform ObjectPushConstants {
+	mat4 model;
+	uint material_index;
+} push;
 
 layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec3 in_color;
 layout(location = 2) in vec2 in_uv;
 layout(location = 3) in vec3 in_normal;
 layout(location = 4) in vec3 in_tangent;
+layout(location = 5) in mat4 in_instance; //identity unless the model is instanced
 
 layout(location = 0) out vec3 out_uv;
 
@@ -34,5 +45,6 @@ void main()
 {
     out_uv = in_pos;
     //out_uv.yz *= -1.0f;
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(in_pos, 1.0);
+    mat4 model = (PUSH_CONSTANT_TRANSFORM ? push.model : object.model) * in_instance;
+    gl_Position = scene.proj * scene.view * model * vec4(in_pos, 1.0);
 }
\ No newline at end of file
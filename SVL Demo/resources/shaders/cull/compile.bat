@@ -0,0 +1,3 @@
+"D:\lib\VulkanSDK\1.2.154.1\Bin\glslangValidator.exe" -V cull.comp
+"D:\lib\VulkanSDK\1.2.154.1\Bin\glslangValidator.exe" -V hiz.comp -o hiz.spv
+pause
\ No newline at end of file
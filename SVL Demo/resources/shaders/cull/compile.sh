@@ -0,0 +1,2 @@
+glslangValidator -V cull.comp
+glslangValidator -V hiz.comp -o hiz.spv
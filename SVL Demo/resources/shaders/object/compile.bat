@@ -1,3 +1,4 @@
 "D:\lib\VulkanSDK\1.2.154.1\Bin\glslangValidator.exe" -V shader.vert
 "D:\lib\VulkanSDK\1.2.154.1\Bin\glslangValidator.exe" -V shader.frag
+"D:\lib\VulkanSDK\1.2.154.1\Bin\glslangValidator.exe" -V bindless.frag -o bindless.spv
 pause
\ No newline at end of file
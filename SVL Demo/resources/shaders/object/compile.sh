@@ -1,2 +1,3 @@
 glslangValidator -V shader.vert
 glslangValidator -V shader.frag
+glslangValidator -V bindless.frag -o bindless.spv
@@ -9,13 +9,12 @@ struct PointLight
     vec4 params;
 };
 
-layout(set = 0, binding = 1) uniform UniformBufferObject {
-	mat4 model;
+layout(set = 0, binding = 0) uniform SceneUniforms {
 	mat4 view;
 	mat4 proj;
 	vec4 view_pos;
     PointLight point_light[NR_POINT_LIGHTS];
-} ubo;
+} scene;
 
 layout(location = 0) in vec3 in_color;
 layout(location = 1) in vec2 in_uv;
@@ -46,7 +45,11 @@ const float GOLDEN_RATIO = 0.618034;
 vec3 get_normal(vec2 uv)
 {
     if(mat.has_normal_tex)
-        return normalize(TBN * (texture(texture_normal, uv).rgb * 2.0 - 1.0));
+    {
+        //z rebuilt from x and y, bc5 normal maps only store two channels
+        vec2 xy = texture(texture_normal, uv).rg * 2.0 - 1.0;
+        return normalize(TBN * vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0))));
+    }
     else
         return normalize(in_normal);
 }
@@ -188,7 +191,7 @@ vec3 get_specular(vec3 N, vec3 L, vec3 V, vec3 F0, float metallic, float roughne
 
 void main()
 {
-    vec3 V = normalize(ubo.view_pos.xyz - in_world_pos);
+    vec3 V = normalize(scene.view_pos.xyz - in_world_pos);
     vec2 uv = get_uv(normalize(transpose(TBN) * V));
 
     vec3 albedo = pow(texture(texture_color, uv).rgb, vec3(2.2));
@@ -204,14 +207,14 @@ void main()
     vec3 Lo = vec3(0.0);
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
     {
-        if(ubo.point_light[i].color.a != 1.0f)
+        if(scene.point_light[i].color.a != 1.0f)
             continue;
 
-        vec3 L = normalize(ubo.point_light[i].position.xyz - in_world_pos);
+        vec3 L = normalize(scene.point_light[i].position.xyz - in_world_pos);
 
         float dist = length(L);
-        float attenuation = pow(ubo.point_light[i].params.x / max(dist, 0.0001), 2.0);
-        vec3 radiance = ubo.point_light[i].color.rgb * attenuation;
+        float attenuation = pow(scene.point_light[i].params.x / max(dist, 0.0001), 2.0);
+        vec3 radiance = scene.point_light[i].color.rgb * attenuation;
         
         Lo += get_specular(N, L, V, F0, metallic, roughness, albedo) * radiance;
     }
@@ -0,0 +1,123 @@
+#include <SVL/graphics/bvh.h>
+#include <SVL/graphics/culling.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+//frustum culling over 100k boxes, every kernel and the bvh are checked against the scalar kernel
+static const uint32_t box_count = 100000;
+static const uint32_t frustum_count = 8;
+static const uint32_t repeats = 50;
+
+static const char* kernel_name(SVL::CullKernel kernel)
+{
+	switch (kernel)
+	{
+	case SVL::AVXCullKernel: return "avx";
+	case SVL::SSE2CullKernel: return "sse2";
+	default: return "scalar";
+	}
+}
+
+//fastest of the repeats in milliseconds, visible holds the result of the last run
+template<class F>
+static double measure(F cull)
+{
+	double best = 1e30;
+	for (uint32_t r = 0; r < repeats; r++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		cull();
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+		if (time.count() < best)
+			best = time.count();
+	}
+	return best;
+}
+
+static uint32_t mismatches(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+	uint32_t result = 0;
+	for (uint32_t i = 0; i < box_count; i++)
+		result += (a[i] != 0) != (b[i] != 0);
+	return result;
+}
+
+int main()
+{
+	//multiples of 1/64 so the center and extent form and the min and max form are the same boxes exactly
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> position(-512 * 64, 512 * 64);
+	std::uniform_int_distribution<int> size(1, 4 * 64);
+
+	SVL::BoundsArray bounds;
+	bounds.resize(box_count);
+	std::vector<SVL::BVH::Box> boxes(box_count);
+	for (uint32_t i = 0; i < box_count; i++)
+	{
+		glm::vec3 center(position(random) / 64.0f, position(random) / 64.0f, position(random) / 64.0f);
+		glm::vec3 extent(size(random) / 64.0f, size(random) / 64.0f, size(random) / 64.0f);
+		bounds.set(i, center, extent);
+		boxes[i] = { center - extent, center + extent };
+	}
+	SVL::BVH bvh;
+	bvh.build(boxes);
+
+	std::vector<SVL::Frustum> frusta(frustum_count);
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+	for (uint32_t f = 0; f < frustum_count; f++)
+	{
+		float angle = glm::radians(360.0f) * f / frustum_count;
+		glm::vec3 eye(std::cos(angle) * 100.0f, 20.0f, std::sin(angle) * 100.0f);
+		frusta[f] = SVL::Frustum::from_matrix(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	}
+
+	std::cout << box_count << " boxes, " << frustum_count << " frusta, best of " << repeats << " runs" << std::endl;
+
+	std::vector<std::vector<uint8_t>> reference(frustum_count, std::vector<uint8_t>(box_count));
+	for (uint32_t f = 0; f < frustum_count; f++)
+		bounds.cull(frusta[f], reference[f].data(), 0, box_count, SVL::ScalarCullKernel);
+
+	uint32_t failed = 0;
+	std::vector<uint8_t> visible(box_count);
+	const SVL::CullKernel kernels[] = { SVL::ScalarCullKernel, SVL::SSE2CullKernel, SVL::AVXCullKernel };
+	for (SVL::CullKernel kernel : kernels)
+	{
+		if (!SVL::BoundsArray::kernel_supported(kernel))
+		{
+			std::cout << kernel_name(kernel) << ": not compiled in, skipped" << std::endl;
+			continue;
+		}
+		double time = 0.0;
+		uint32_t wrong = 0;
+		for (uint32_t f = 0; f < frustum_count; f++)
+		{
+			time += measure([&]() { bounds.cull(frusta[f], visible.data(), 0, box_count, kernel); });
+			wrong += mismatches(visible, reference[f]);
+		}
+		std::cout << kernel_name(kernel) << ": " << time / frustum_count << " ms per frustum, " << wrong << " mismatches" << std::endl;
+		failed += wrong;
+	}
+
+	double time = 0.0;
+	uint32_t wrong = 0, count = 0;
+	for (uint32_t f = 0; f < frustum_count; f++)
+	{
+		time += measure([&]() { bvh.cull(frusta[f], visible.data()); });
+		wrong += mismatches(visible, reference[f]);
+		for (uint8_t v : reference[f])
+			count += v;
+	}
+	std::cout << "bvh (" << kernel_name(SVL::BoundsArray::best_kernel()) << " leaves): " << time / frustum_count << " ms per frustum, " << wrong << " mismatches" << std::endl;
+	std::cout << count / frustum_count << " boxes visible per frustum on average" << std::endl;
+	failed += wrong;
+
+	return failed == 0 ? 0 : 1;
+}
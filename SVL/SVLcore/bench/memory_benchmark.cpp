@@ -0,0 +1,92 @@
+#include <SVL/graphics/renderer.h>
+#include <SVL/graphics/memory.h>
+#include <SVL/graphics/tools.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+//creates, partly frees and recreates buffers once with one vkAllocateMemory per buffer and once sub-allocated
+static const uint32_t max_buffer_count = 2048;
+
+struct Buffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	SVL::Allocation allocation;
+};
+
+static double milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+	return time.count();
+}
+
+static void print_stats(const char* phase, double time, const SVL::MemoryStats& stats)
+{
+	std::cout << "  " << phase << ": " << time << " ms, " << stats.block_count << " blocks, " << stats.allocation_count << " allocations, "
+		<< stats.used_bytes / 1024 << " KiB used of " << stats.reserved_bytes / 1024 << " KiB reserved" << std::endl;
+}
+
+static void run(const SVL::Renderer& renderer, bool sub_allocation, uint32_t buffer_count)
+{
+	SVL::MemoryAllocator& allocator = renderer.allocator();
+	allocator.set_sub_allocation(sub_allocation);
+	SVL::MemoryStats before = allocator.stats();
+	std::cout << (sub_allocation ? "sub-allocation" : "one allocation per buffer") << std::endl;
+
+	//same sizes and memory types for both runs
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> size(1, 256);
+	std::vector<VkDeviceSize> sizes(buffer_count);
+	for (VkDeviceSize& s : sizes)
+		s = size(random) * 1024;
+	auto create = [&](Buffer& b, uint32_t i)
+	{
+		//every fourth buffer is host visible like uniform and staging buffers
+		VkMemoryPropertyFlags properties = i % 4 == 0 ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		SVLTools::create_buffer(renderer, sizes[i], VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, &b.buffer, &b.allocation);
+	};
+
+	std::vector<Buffer> buffers(buffer_count);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < buffer_count; i++)
+		create(buffers[i], i);
+	print_stats("create", milliseconds(start), allocator.stats());
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < buffer_count; i += 2)
+		SVLTools::destroy_buffer(renderer, buffers[i].buffer, buffers[i].allocation);
+	print_stats("free every second", milliseconds(start), allocator.stats());
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < buffer_count; i += 2)
+		create(buffers[i], i);
+	print_stats("recreate", milliseconds(start), allocator.stats());
+
+	start = std::chrono::high_resolution_clock::now();
+	for (Buffer& b : buffers)
+		SVLTools::destroy_buffer(renderer, b.buffer, b.allocation);
+	SVL::MemoryStats after = allocator.stats();
+	print_stats("destroy", milliseconds(start), after);
+
+	std::cout << "  vkAllocateMemory calls: " << after.total_block_allocations - before.total_block_allocations
+		<< ", allocations: " << after.total_allocations - before.total_allocations << std::endl;
+}
+
+int main()
+{
+	//no validation and no pipeline cache file, cpu implementations are picked when there is no gpu
+	SVL::Renderer renderer("SVL memory benchmark", 1, false, NUM_FRAMES_IN_FLIGHT, "");
+	std::cout << renderer.properties().deviceName << std::endl;
+
+	//without sub-allocation every buffer counts against maxMemoryAllocationCount
+	uint32_t buffer_count = std::min(max_buffer_count, renderer.properties().limits.maxMemoryAllocationCount / 2);
+	std::cout << buffer_count << " buffers of 1 to 256 KiB" << std::endl;
+
+	run(renderer, false, buffer_count);
+	run(renderer, true, buffer_count);
+	return 0;
+}
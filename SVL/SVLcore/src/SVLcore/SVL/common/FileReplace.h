@@ -0,0 +1,24 @@
+#ifndef FILE_REPLACE
+#define FILE_REPLACE
+#include <string>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cstdio>
+#endif
+//moves source over target in one step, target is either the old or the new file and never missing
+static bool ReplaceFileAtomic(const std::string& source, const std::string& target)
+{
+#ifdef _WIN32
+	return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(source.c_str(), target.c_str()) == 0;
+#endif
+}
+#endif // !FILE_REPLACE
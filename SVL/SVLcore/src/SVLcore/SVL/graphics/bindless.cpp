@@ -0,0 +1,249 @@
+#include "bindless.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include <algorithm>
+
+#include "renderer.h"
+#include "material.h"
+#include "texture.h"
+#include "tools.h"
+#include "pipeline.h"
+
+SVL::BindlessMaterials::BindlessMaterials(const Renderer& renderer, uint32_t textures, uint32_t materials)
+	: vk_renderer(renderer), texture_capacity(textures), material_capacity(materials)
+{
+	//update after bind limits are separate from the regular ones, one sampler is left for the environment
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_properties{};
+	indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &indexing_properties;
+	vkGetPhysicalDeviceProperties2(vk_renderer.physical_device(), &properties2);
+	uint32_t limit = std::min({ indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages, indexing_properties.maxDescriptorSetUpdateAfterBindSamplers,
+		indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+		indexing_properties.maxPerStageUpdateAfterBindResources - 1 });
+	texture_capacity = std::min(texture_capacity, limit - 1);
+
+	free_materials.resize(material_capacity);
+	for (uint32_t i = 0; i < material_capacity; i++)
+		free_materials[i] = material_capacity - 1 - i; //lowest index handed out first
+	material_textures.resize(material_capacity);
+
+	SVLTools::create_buffer(vk_renderer, (VkDeviceSize)material_capacity * sizeof(Entry), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &material_buffer, &material_allocation);
+
+	//the default texture sampler is baked into the layout for every element
+	std::vector<VkSampler> immutable_samplers(texture_capacity, vk_renderer.pipelines().sampler(Texture::sampler_info(0)));
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].pImmutableSamplers = immutable_samplers.data();
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[2].descriptorCount = texture_capacity;
+	bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[2].pImmutableSamplers = immutable_samplers.data();
+
+	//array elements are written while frames using the others are recorded or pending
+	std::array<VkDescriptorBindingFlagsEXT, 3> binding_flags{};
+	binding_flags[2] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info{};
+	binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	binding_flags_info.bindingCount = (uint32_t)binding_flags.size();
+	binding_flags_info.pBindingFlags = binding_flags.data();
+
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.pNext = &binding_flags_info;
+	layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layout_info.bindingCount = (uint32_t)bindings.size();
+	layout_info.pBindings = bindings.data();
+	ErrorCheck(vkCreateDescriptorSetLayout(vk_renderer.device(), &layout_info, nullptr, &vk_descriptor_set_layout));
+
+	std::array<VkDescriptorPoolSize, 2> pool_sizes{};
+	pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_sizes[0].descriptorCount = 1;
+	pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	pool_sizes[1].descriptorCount = texture_capacity + 1;
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = (uint32_t)pool_sizes.size();
+	pool_info.pPoolSizes = pool_sizes.data();
+	ErrorCheck(vkCreateDescriptorPool(vk_renderer.device(), &pool_info, nullptr, &vk_descriptor_pool));
+
+	VkDescriptorSetAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocate_info.descriptorPool = vk_descriptor_pool;
+	allocate_info.descriptorSetCount = 1;
+	allocate_info.pSetLayouts = &vk_descriptor_set_layout;
+	ErrorCheck(vkAllocateDescriptorSets(vk_renderer.device(), &allocate_info, &vk_descriptor_set));
+
+	VkDescriptorBufferInfo material_descriptor{ material_buffer, 0, VK_WHOLE_SIZE };
+	VkWriteDescriptorSet material_write{};
+	material_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	material_write.dstSet = vk_descriptor_set;
+	material_write.dstBinding = 0;
+	material_write.dstArrayElement = 0;
+	material_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	material_write.descriptorCount = 1;
+	material_write.pBufferInfo = &material_descriptor;
+	vkUpdateDescriptorSets(vk_renderer.device(), 1, &material_write, 0, nullptr);
+}
+
+SVL::BindlessMaterials::~BindlessMaterials()
+{
+	vkDestroyDescriptorPool(vk_renderer.device(), vk_descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(vk_renderer.device(), vk_descriptor_set_layout, nullptr);
+	SVLTools::destroy_buffer(vk_renderer, material_buffer, material_allocation);
+}
+
+bool SVL::BindlessMaterials::supported(const Renderer& renderer)
+{
+	return renderer.descriptor_indexing();
+}
+
+bool SVL::BindlessMaterials::add(Material& material)
+{
+	if (free_materials.empty())
+	{
+		Log("SVL: bindless material table is full.");
+		return false;
+	}
+	//textures not in the array yet must fit, missing ones fall back to diffuse
+	const Texture* used[] = { material.textures.diffuse, material.textures.normal, material.textures.metalness_roughness, material.textures.ambient_occulsion, material.textures.displacement };
+	uint32_t missing = 0;
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		if (used[i] == nullptr || textures.count(used[i]) != 0 || std::find(used, used + i, used[i]) != used + i) continue;
+		missing++;
+	}
+	if (missing > free_textures.size() + (texture_capacity - texture_end))
+	{
+		Log("SVL: bindless texture array is full.");
+		return false;
+	}
+
+	material.bindless_index = free_materials.back();
+	free_materials.pop_back();
+	material_textures[material.bindless_index].fill(nullptr);
+	update(material);
+	return true;
+}
+
+void SVL::BindlessMaterials::update(const Material& material)
+{
+	if (material.bindless_index >= material_capacity) return;
+	const Texture* diffuse = material.textures.diffuse;
+	std::array<const Texture*, 5> used = {
+		diffuse,
+		material.textures.normal != nullptr ? material.textures.normal : diffuse,
+		material.textures.metalness_roughness != nullptr ? material.textures.metalness_roughness : diffuse,
+		material.textures.ambient_occulsion != nullptr ? material.textures.ambient_occulsion : diffuse,
+		material.textures.displacement != nullptr ? material.textures.displacement : diffuse
+	};
+
+	//acquired before the previous ones are released, so textures the material keeps keep their index
+	std::array<uint32_t, 5> indices;
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		indices[i] = acquire(used[i]);
+		if (indices[i] == UINT32_MAX)
+		{
+			Log("SVL: bindless texture array is full, material falls back to its diffuse texture.");
+			indices[i] = indices[0] != UINT32_MAX ? indices[0] : 0;
+			used[i] = nullptr;
+		}
+	}
+	std::array<const Texture*, 5>& previous = material_textures[material.bindless_index];
+	for (const Texture* texture : previous)
+		release(texture);
+	previous = used;
+
+	Entry& entry = static_cast<Entry*>(material_allocation.mapped)[material.bindless_index];
+	entry.diffuse = indices[0];
+	entry.normal = indices[1];
+	entry.metalness_roughness = indices[2];
+	entry.ambient_occlusion = indices[3];
+	entry.height = indices[4];
+	entry.has_normal_tex = material.properties.has_normal_tex ? 1 : 0;
+	entry.has_ao_tex = material.properties.has_ao_tex;
+	entry.has_height_tex = material.properties.has_height_tex ? 1 : 0;
+}
+
+void SVL::BindlessMaterials::remove(Material& material)
+{
+	if (material.bindless_index >= material_capacity) return;
+	std::array<const Texture*, 5>& previous = material_textures[material.bindless_index];
+	for (const Texture* texture : previous)
+		release(texture);
+	previous.fill(nullptr);
+	free_materials.push_back(material.bindless_index);
+	material.bindless_index = UINT32_MAX;
+}
+
+void SVL::BindlessMaterials::set_environment(Texture* environment)
+{
+	VkWriteDescriptorSet environment_write{};
+	environment_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	environment_write.dstSet = vk_descriptor_set;
+	environment_write.dstBinding = 1;
+	environment_write.dstArrayElement = 0;
+	environment_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	environment_write.descriptorCount = 1;
+	environment_write.pImageInfo = &environment->descriptor;
+	vkUpdateDescriptorSets(vk_renderer.device(), 1, &environment_write, 0, nullptr);
+}
+
+uint32_t SVL::BindlessMaterials::acquire(const Texture* texture)
+{
+	if (texture == nullptr) return UINT32_MAX;
+	auto slot = textures.find(texture);
+	if (slot != textures.end())
+	{
+		slot->second.references++;
+		return slot->second.index;
+	}
+
+	uint32_t index;
+	if (!free_textures.empty())
+	{
+		index = free_textures.back();
+		free_textures.pop_back();
+	}
+	else if (texture_end < texture_capacity)
+		index = texture_end++;
+	else
+		return UINT32_MAX;
+
+	VkWriteDescriptorSet texture_write{};
+	texture_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	texture_write.dstSet = vk_descriptor_set;
+	texture_write.dstBinding = 2;
+	texture_write.dstArrayElement = index;
+	texture_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	texture_write.descriptorCount = 1;
+	texture_write.pImageInfo = &texture->descriptor;
+	vkUpdateDescriptorSets(vk_renderer.device(), 1, &texture_write, 0, nullptr);
+
+	textures[texture] = { index, 1 };
+	return index;
+}
+
+void SVL::BindlessMaterials::release(const Texture* texture)
+{
+	if (texture == nullptr) return;
+	auto slot = textures.find(texture);
+	if (slot == textures.end()) return;
+	if (--slot->second.references == 0)
+	{
+		free_textures.push_back(slot->second.index);
+		textures.erase(slot);
+	}
+}
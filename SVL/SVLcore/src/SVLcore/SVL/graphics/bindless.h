@@ -0,0 +1,93 @@
+#ifndef BINDLESS_H
+#define BINDLESS_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+
+#include "memory.h"
+
+namespace SVL
+{
+	class Renderer;
+	class Texture;
+	class Material;
+
+	//set 1 of bindless layers, bound once instead of a set per material
+	//binding 0 - material storage buffer, binding 1 - environment cube, binding 2 - array of every material texture
+	//draws select their material through the pushed material index, textures are shared between materials using them
+	class DLLDIR BindlessMaterials
+	{
+	public:
+		//std430, texture indices into binding 2
+		struct Entry
+		{
+			uint32_t diffuse;
+			uint32_t normal;
+			uint32_t metalness_roughness;
+			uint32_t ambient_occlusion;
+			uint32_t height;
+			uint32_t has_normal_tex;
+			uint32_t has_ao_tex;
+			uint32_t has_height_tex;
+		};
+
+		//textures is clamped to the device limits
+		BindlessMaterials(const Renderer& renderer, uint32_t textures = BINDLESS_TEXTURES, uint32_t materials = BINDLESS_MATERIALS);
+		~BindlessMaterials();
+
+		BindlessMaterials(const BindlessMaterials&) = delete;
+		BindlessMaterials& operator=(const BindlessMaterials&) = delete;
+		BindlessMaterials(BindlessMaterials&&) = delete;
+		BindlessMaterials& operator=(BindlessMaterials&&) = delete;
+
+		static bool supported(const Renderer& renderer);
+
+		//stores the index in material.bindless_index, false when the material or texture array is full
+		//recorded frames stay valid, only unused array elements are written
+		bool add(Material& material);
+		//rewrites the entry after the material properties or textures changed
+		void update(const Material& material);
+		//the material must no longer be used by frames in flight
+		void remove(Material& material);
+		//not written after bind, frames recorded before must not be pending and are re-recorded
+		void set_environment(Texture* environment);
+
+		const VkDescriptorSetLayout descriptor_set_layout() const { return vk_descriptor_set_layout; }
+		const VkDescriptorSet descriptor_set() const { return vk_descriptor_set; }
+		const uint32_t textures_count() const { return (uint32_t)textures.size(); }
+		const uint32_t materials_count() const { return material_capacity - (uint32_t)free_materials.size(); }
+	private:
+		struct Slot
+		{
+			uint32_t index;
+			uint32_t references;
+		};
+
+		const class Renderer& vk_renderer;
+		uint32_t texture_capacity;
+		const uint32_t material_capacity;
+
+		std::unordered_map<const Texture*, Slot> textures;
+		std::vector<uint32_t> free_textures; //released indices, reused before the array grows
+		uint32_t texture_end = 0;
+		std::vector<uint32_t> free_materials;
+		std::vector<std::array<const Texture*, 5>> material_textures; //per material index, released on remove
+
+		VkBuffer material_buffer = VK_NULL_HANDLE; //host visible, material_capacity entries
+		Allocation material_allocation;
+
+		VkDescriptorPool vk_descriptor_pool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout vk_descriptor_set_layout = VK_NULL_HANDLE;
+		VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE;
+
+		//index of the texture in binding 2, UINT32_MAX when the array is full
+		uint32_t acquire(const Texture* texture);
+		void release(const Texture* texture);
+	};
+}
+
+#endif // !BINDLESS_H
@@ -0,0 +1,331 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static const uint32_t bvh_leaf_size = 4;
+static const uint32_t bvh_bins = 12;
+
+static SVL::BVH::Box empty_box()
+{
+	return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+static void grow(SVL::BVH::Box& box, const SVL::BVH::Box& other)
+{
+	box.min = glm::min(box.min, other.min);
+	box.max = glm::max(box.max, other.max);
+}
+static float area(const SVL::BVH::Box& box)
+{
+	glm::vec3 e = glm::max(box.max - box.min, glm::vec3(0.0f));
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+static bool overlaps(const SVL::BVH::Box& a, const SVL::BVH::Box& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+//0 - outside, 1 - crossing a plane, 2 - inside
+static int classify(const SVL::Frustum& frustum, const SVL::BVH::Box& box)
+{
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	int result = 2;
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float r = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		if (d + r < 0.0f) return 0;
+		if (d - r < 0.0f) result = 1;
+	}
+	return result;
+}
+
+//slab test, distance to the entry point or FLT_MAX on a miss
+static float intersect(const SVL::BVH::Box& box, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance)
+{
+	glm::vec3 t0 = (box.min - origin) * inverse_direction;
+	glm::vec3 t1 = (box.max - origin) * inverse_direction;
+	glm::vec3 near_t = glm::min(t0, t1);
+	glm::vec3 far_t = glm::max(t0, t1);
+	float enter = std::max(std::max(near_t.x, near_t.y), std::max(near_t.z, 0.0f));
+	float exit = std::min(std::min(far_t.x, far_t.y), std::min(far_t.z, max_distance));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+SVL::BVH::Box SVL::BVH::Box::transformed(const glm::vec3& local_min, const glm::vec3& local_max, const glm::mat4& transform)
+{
+	glm::vec3 local_center = (local_min + local_max) * 0.5f;
+	glm::vec3 local_extent = (local_max - local_min) * 0.5f;
+
+	glm::vec3 center = glm::vec3(transform * glm::vec4(local_center, 1.0f));
+	glm::vec3 extent;
+	for (int i = 0; i < 3; i++)
+		extent[i] = std::fabs(transform[0][i]) * local_extent.x + std::fabs(transform[1][i]) * local_extent.y + std::fabs(transform[2][i]) * local_extent.z;
+	return { center - extent, center + extent };
+}
+
+void SVL::BVH::build(const std::vector<Box>& boxes)
+{
+	uint32_t count = (uint32_t)boxes.size();
+	item_boxes = boxes;
+	slot_items.resize(count);
+	item_slots.resize(count);
+	item_leaves.resize(count);
+	slot_visible.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+		slot_items[i] = i;
+	refit_count = 0;
+
+	nodes.clear();
+	if (count > 0)
+	{
+		nodes.reserve(2 * count);
+		nodes.push_back(Node());
+		build_node(0, 0, count, UINT32_MAX);
+	}
+
+	slot_bounds.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		item_slots[slot_items[i]] = i;
+		set_slot(i);
+	}
+}
+
+void SVL::BVH::build_node(uint32_t index, uint32_t first, uint32_t count, uint32_t parent)
+{
+	Box box = empty_box(), centroids = empty_box();
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const Box& b = item_boxes[slot_items[i]];
+		grow(box, b);
+		glm::vec3 c = (b.min + b.max) * 0.5f;
+		grow(centroids, { c, c });
+	}
+	nodes[index] = { box, first, count, UINT32_MAX, parent };
+
+	//binned sah along the widest centroid axis
+	uint32_t split = 0;
+	if (count > bvh_leaf_size)
+	{
+		glm::vec3 extent = centroids.max - centroids.min;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		if (extent[axis] > 0.0f)
+		{
+			float low = centroids.min[axis];
+			float scale = bvh_bins / extent[axis];
+			auto bin_of = [&](uint32_t item)
+			{
+				const Box& b = item_boxes[item];
+				float c = (b.min[axis] + b.max[axis]) * 0.5f;
+				return std::min(bvh_bins - 1, (uint32_t)((c - low) * scale));
+			};
+
+			Box bin_boxes[bvh_bins];
+			uint32_t bin_counts[bvh_bins] = {};
+			for (uint32_t b = 0; b < bvh_bins; b++)
+				bin_boxes[b] = empty_box();
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				uint32_t b = bin_of(slot_items[i]);
+				bin_counts[b]++;
+				grow(bin_boxes[b], item_boxes[slot_items[i]]);
+			}
+
+			//plane b splits bins below b from the rest
+			float right_areas[bvh_bins];
+			uint32_t right_counts[bvh_bins];
+			Box right = empty_box();
+			uint32_t right_count = 0;
+			for (uint32_t b = bvh_bins - 1; b > 0; b--)
+			{
+				grow(right, bin_boxes[b]);
+				right_count += bin_counts[b];
+				right_areas[b] = area(right);
+				right_counts[b] = right_count;
+			}
+			float best_cost = area(box) * count; //keeping a leaf
+			uint32_t best_plane = 0;
+			Box left = empty_box();
+			uint32_t left_count = 0;
+			for (uint32_t b = 1; b < bvh_bins; b++)
+			{
+				grow(left, bin_boxes[b - 1]);
+				left_count += bin_counts[b - 1];
+				if (left_count == 0 || right_counts[b] == 0)
+					continue;
+				float cost = area(left) * left_count + right_areas[b] * right_counts[b];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_plane = b;
+				}
+			}
+			if (best_plane != 0)
+			{
+				uint32_t* begin = slot_items.data() + first;
+				split = (uint32_t)(std::partition(begin, begin + count, [&](uint32_t item) { return bin_of(item) < best_plane; }) - begin);
+			}
+		}
+		//stacked items or splits worse than a leaf, large leaves would make every query linear
+		if ((split == 0 || split == count) && count > 4 * bvh_leaf_size)
+			split = count / 2;
+	}
+
+	if (split == 0 || split == count)
+	{
+		for (uint32_t i = first; i < first + count; i++)
+			item_leaves[slot_items[i]] = index;
+		return;
+	}
+
+	uint32_t left_index = (uint32_t)nodes.size();
+	nodes[index].left = left_index;
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	build_node(left_index, first, split, index);
+	build_node(left_index + 1, first + split, count - split, index);
+}
+
+void SVL::BVH::set_slot(uint32_t slot)
+{
+	const Box& b = item_boxes[slot_items[slot]];
+	slot_bounds.set(slot, (b.min + b.max) * 0.5f, (b.max - b.min) * 0.5f);
+}
+
+void SVL::BVH::update(uint32_t item, const Box& box)
+{
+	item_boxes[item] = box;
+	set_slot(item_slots[item]);
+
+	//ancestors only grow or shrink until they match their children again
+	uint32_t index = item_leaves[item];
+	while (index != UINT32_MAX)
+	{
+		Node& node = nodes[index];
+		Box refit = empty_box();
+		if (node.left == UINT32_MAX)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+				grow(refit, item_boxes[slot_items[i]]);
+		}
+		else
+		{
+			refit = nodes[node.left].box;
+			grow(refit, nodes[node.left + 1].box);
+		}
+		if (refit.min == node.box.min && refit.max == node.box.max)
+			break;
+		node.box = refit;
+		index = node.parent;
+	}
+	refit_count++;
+}
+
+void SVL::BVH::cull(const Frustum& frustum, uint8_t* visible) const
+{
+	if (nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		int result = classify(frustum, node.box);
+		if (result != 1 || node.left == UINT32_MAX)
+		{
+			if (result == 1)
+				slot_bounds.cull(frustum, slot_visible.data(), node.first, node.count);
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+				visible[slot_items[i]] = result == 1 ? slot_visible[i] : result == 2;
+			continue;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.left + 1);
+	}
+}
+
+void SVL::BVH::query(const Frustum& frustum, std::vector<uint32_t>& items) const
+{
+	items.clear();
+	std::vector<uint8_t> visible(item_boxes.size());
+	cull(frustum, visible.data());
+	for (uint32_t i = 0; i < visible.size(); i++)
+		if (visible[i])
+			items.push_back(i);
+}
+
+void SVL::BVH::query(const Box& box, std::vector<uint32_t>& items) const
+{
+	items.clear();
+	if (nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!overlaps(node.box, box))
+			continue;
+		if (node.left != UINT32_MAX)
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.left + 1);
+			continue;
+		}
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+			if (overlaps(item_boxes[slot_items[i]], box))
+				items.push_back(slot_items[i]);
+	}
+}
+
+uint32_t SVL::BVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, float* distance) const
+{
+	uint32_t hit = UINT32_MAX;
+	if (nodes.empty())
+		return hit;
+
+	//infinities for axis parallel rays keep the slab test valid
+	glm::vec3 inverse_direction = 1.0f / direction;
+	float nearest = max_distance;
+
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (intersect(node.box, origin, inverse_direction, nearest) == FLT_MAX)
+			continue;
+		if (node.left == UINT32_MAX)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				float t = intersect(item_boxes[slot_items[i]], origin, inverse_direction, nearest);
+				if (t != FLT_MAX && (t < nearest || hit == UINT32_MAX))
+				{
+					nearest = t;
+					hit = slot_items[i];
+				}
+			}
+			continue;
+		}
+		//nearer child popped first so farther subtrees are clipped by its hits
+		float t_left = intersect(nodes[node.left].box, origin, inverse_direction, nearest);
+		float t_right = intersect(nodes[node.left + 1].box, origin, inverse_direction, nearest);
+		uint32_t near_child = t_left <= t_right ? node.left : node.left + 1;
+		float t_far = t_left <= t_right ? t_right : t_left;
+		if (t_far != FLT_MAX)
+			stack.push_back(near_child == node.left ? node.left + 1 : node.left);
+		if (std::min(t_left, t_right) != FLT_MAX)
+			stack.push_back(near_child);
+	}
+
+	if (distance && hit != UINT32_MAX)
+		*distance = nearest;
+	return hit;
+}
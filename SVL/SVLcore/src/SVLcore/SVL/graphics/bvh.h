@@ -0,0 +1,67 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <SVL/definitions.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "culling.h"
+
+namespace SVL
+{
+	//bounding volume hierarchy over world space boxes, items are identified by their index in build()
+	//built with binned sah, moved items only refit their ancestors until rebuild_needed()
+	class DLLDIR BVH
+	{
+	public:
+		struct Box
+		{
+			glm::vec3 min;
+			glm::vec3 max;
+
+			//box enclosing the transformed local box
+			static Box transformed(const glm::vec3& local_min, const glm::vec3& local_max, const glm::mat4& transform);
+		};
+
+		void build(const std::vector<Box>& boxes);
+		//refits the item leaf and its ancestors
+		void update(uint32_t item, const Box& box);
+		//refitted trees loosen as items move away from where they were built
+		const bool rebuild_needed() const { return refit_count > item_boxes.size(); }
+		const uint32_t size() const { return (uint32_t)item_boxes.size(); }
+		const Box& bounds(uint32_t item) const { return item_boxes[item]; }
+		const std::vector<Box>& get_bounds() const { return item_boxes; }
+
+		//visible[item] - 1 if the item box intersects the frustum, subtrees fully inside or outside are not descended
+		void cull(const Frustum& frustum, uint8_t* visible) const;
+		void query(const Frustum& frustum, std::vector<uint32_t>& items) const;
+		void query(const Box& box, std::vector<uint32_t>& items) const;
+		//nearest item whose box the ray enters within max_distance, UINT32_MAX if none
+		uint32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, float* distance = nullptr) const;
+	private:
+		struct Node
+		{
+			Box box;
+			uint32_t first; //slot range of the subtree
+			uint32_t count;
+			uint32_t left; //right child is left + 1, UINT32_MAX for leaves
+			uint32_t parent;
+		};
+
+		std::vector<Node> nodes;
+		std::vector<Box> item_boxes;
+		std::vector<uint32_t> slot_items; //leaf order, every subtree is a contiguous range
+		std::vector<uint32_t> item_slots;
+		std::vector<uint32_t> item_leaves;
+		BoundsArray slot_bounds; //leaves crossing a plane are tested with the simd frustum test
+		mutable std::vector<uint8_t> slot_visible;
+		uint32_t refit_count = 0;
+
+		void build_node(uint32_t index, uint32_t first, uint32_t count, uint32_t parent);
+		void set_slot(uint32_t slot);
+	};
+}
+
+#endif // !BVH_H
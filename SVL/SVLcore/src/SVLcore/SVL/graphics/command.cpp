@@ -2,6 +2,7 @@
 
 #include <SVL/common/ErrorHandler.h>
 #include "renderer.h"
+#include "thread_pool.h"
 
 SVL::Command::Command(const Renderer& renderer)
 	: vk_renderer(renderer)
@@ -51,4 +52,16 @@ void SVL::SecCommand::create_command_buffers(uint32_t size)
 	command_buffer_allocate_info.commandBufferCount = vk_command_buffers.size();
 
 	ErrorCheck(vkAllocateCommandBuffers(vk_renderer.device(), &command_buffer_allocate_info, vk_command_buffers.data()));
+}
+
+void SVL::SecCommand::record_command_buffers(VkCommandBufferInheritanceInfo inheritance_info, uint32_t index, ThreadPool& pool)
+{
+	pool.push([this, inheritance_info, index]() { update_command_buffers(inheritance_info, index); });
+}
+
+std::vector<VkCommandBuffer> SVL::SecCommand::secondary_command_buffers(uint32_t index)
+{
+	if (vk_command_buffers.empty())
+		return {};
+	return { vk_command_buffers[index] };
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 namespace SVL
 {
 	class Renderer;
+	class ThreadPool;
 	class DLLDIR Command
 	{
 	public:
@@ -42,6 +43,13 @@ namespace SVL
 		SecCommand(const Renderer& r) : SVL::Command(r) {}
 		virtual void update() {}
 		virtual void update_command_buffers(VkCommandBufferInheritanceInfo, uint32_t) {}
+		//parallel recording, tasks pushed to pool must not share a command pool
+		//the default records update_command_buffers as a single task
+		virtual void record_command_buffers(VkCommandBufferInheritanceInfo inheritance_info, uint32_t index, ThreadPool& pool);
+		//secondaries executed for frame index, in order
+		virtual std::vector<VkCommandBuffer> secondary_command_buffers(uint32_t index);
+		//recorded into the primary before the render pass begins, e.g. compute work the secondaries consume
+		virtual void record_pre_render_pass(VkCommandBuffer command_buffer, uint32_t index) {}
 	protected:
 		void create_command_buffers(uint32_t);
 	};
@@ -0,0 +1,156 @@
+#include "culling.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#	define SVL_CULL_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define SVL_CULL_SSE
+#endif
+
+SVL::Frustum SVL::Frustum::from_matrix(const glm::mat4& m)
+{
+	//rows of the column major matrix
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = row[3] + row[0]; //left
+	frustum.planes[1] = row[3] - row[0]; //right
+	frustum.planes[2] = row[3] + row[1]; //bottom
+	frustum.planes[3] = row[3] - row[1]; //top
+	frustum.planes[4] = row[3] + row[2]; //near
+	frustum.planes[5] = row[3] - row[2]; //far
+	return frustum;
+}
+
+void SVL::BoundsArray::resize(uint32_t count)
+{
+	this->count = count;
+	size_t padded = (count + 7) / 8 * 8;
+	center_x.assign(padded, 0.0f);
+	center_y.assign(padded, 0.0f);
+	center_z.assign(padded, 0.0f);
+	extent_x.assign(padded, 0.0f);
+	extent_y.assign(padded, 0.0f);
+	extent_z.assign(padded, 0.0f);
+}
+
+void SVL::BoundsArray::set(uint32_t index, const glm::vec3& center, const glm::vec3& extent)
+{
+	center_x[index] = center.x;
+	center_y[index] = center.y;
+	center_z[index] = center.z;
+	extent_x[index] = extent.x;
+	extent_y[index] = extent.y;
+	extent_z[index] = extent.z;
+}
+
+void SVL::BoundsArray::set(uint32_t index, const glm::vec3& local_min, const glm::vec3& local_max, const glm::mat4& transform)
+{
+	glm::vec3 local_center = (local_min + local_max) * 0.5f;
+	glm::vec3 local_extent = (local_max - local_min) * 0.5f;
+
+	glm::vec3 center = glm::vec3(transform * glm::vec4(local_center, 1.0f));
+	glm::vec3 extent;
+	for (int i = 0; i < 3; i++)
+		extent[i] = std::fabs(transform[0][i]) * local_extent.x + std::fabs(transform[1][i]) * local_extent.y + std::fabs(transform[2][i]) * local_extent.z;
+	set(index, center, extent);
+}
+
+void SVL::BoundsArray::set_infinite(uint32_t index)
+{
+	//large but finite, zero plane components must not turn the radius into nan
+	set(index, glm::vec3(0.0f), glm::vec3(1e30f));
+}
+
+SVL::CullKernel SVL::BoundsArray::best_kernel()
+{
+#if defined(SVL_CULL_AVX)
+	return AVXCullKernel;
+#elif defined(SVL_CULL_SSE)
+	return SSE2CullKernel;
+#else
+	return ScalarCullKernel;
+#endif
+}
+
+bool SVL::BoundsArray::kernel_supported(CullKernel kernel)
+{
+	switch (kernel)
+	{
+#if defined(SVL_CULL_AVX)
+	case AVXCullKernel:
+		return true;
+#endif
+#if defined(SVL_CULL_SSE)
+	case SSE2CullKernel:
+		return true;
+#endif
+	case ScalarCullKernel:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void SVL::BoundsArray::cull(const Frustum& frustum, uint8_t* visible, uint32_t first, uint32_t range, CullKernel kernel) const
+{
+	//loads may run into the padding or the next range, results past the range are dropped
+	uint32_t i = first;
+	uint32_t end = first + range;
+#if defined(SVL_CULL_AVX)
+	for (; kernel == AVXCullKernel && i < end && i + 8 <= center_x.size(); i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&center_x[i]), cy = _mm256_loadu_ps(&center_y[i]), cz = _mm256_loadu_ps(&center_z[i]);
+		__m256 ex = _mm256_loadu_ps(&extent_x[i]), ey = _mm256_loadu_ps(&extent_y[i]), ez = _mm256_loadu_ps(&extent_z[i]);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx), _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz), _mm256_set1_ps(plane.w)));
+			__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.y)), ey)),
+				_mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.z)), ez));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for (uint32_t j = 0; j < 8 && i + j < end; j++)
+			visible[i + j] = (mask >> j) & 1;
+	}
+#endif
+#if defined(SVL_CULL_SSE)
+	for (; kernel == SSE2CullKernel && i < end && i + 4 <= center_x.size(); i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&center_x[i]), cy = _mm_loadu_ps(&center_y[i]), cz = _mm_loadu_ps(&center_z[i]);
+		__m128 ex = _mm_loadu_ps(&extent_x[i]), ey = _mm_loadu_ps(&extent_y[i]), ez = _mm_loadu_ps(&extent_z[i]);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), ey)),
+				_mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (uint32_t j = 0; j < 4 && i + j < end; j++)
+			visible[i + j] = (mask >> j) & 1;
+	}
+#endif
+	//same operation order as the simd kernels, every kernel gives the same result
+	for (; i < end; i++)
+	{
+		bool inside = true;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			float d = (plane.x * center_x[i] + plane.y * center_y[i]) + (plane.z * center_z[i] + plane.w);
+			float r = std::fabs(plane.x) * extent_x[i] + std::fabs(plane.y) * extent_y[i] + std::fabs(plane.z) * extent_z[i];
+			inside = inside && d + r >= 0.0f;
+		}
+		visible[i] = inside;
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <SVL/definitions.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace SVL
+{
+	//planes point inwards, not normalized
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+
+		//opengl clip volume, conservative for zero to one depth projections as well
+		static Frustum from_matrix(const glm::mat4& view_projection);
+	};
+
+	//frustum test implementations, only the ones the compiler targets are built
+	enum CullKernel
+	{
+		ScalarCullKernel,
+		SSE2CullKernel,
+		AVXCullKernel
+	};
+
+	//world space boxes as center and half extent, stored as separate arrays so planes are tested against 4 (sse) or 8 (avx) boxes at once
+	class DLLDIR BoundsArray
+	{
+	public:
+		void resize(uint32_t count);
+		const uint32_t size() const { return count; }
+
+		void set(uint32_t index, const glm::vec3& center, const glm::vec3& extent);
+		//transforms the local box and stores the box enclosing the result
+		void set(uint32_t index, const glm::vec3& local_min, const glm::vec3& local_max, const glm::mat4& transform);
+		//never culled
+		void set_infinite(uint32_t index);
+
+		//visible[i] - 1 if the box intersects or is inside the frustum
+		void cull(const Frustum& frustum, uint8_t* visible) const { cull(frustum, visible, 0, count); }
+		//only boxes first to first + range - 1, visible is still indexed from 0
+		void cull(const Frustum& frustum, uint8_t* visible, uint32_t first, uint32_t range) const { cull(frustum, visible, first, range, best_kernel()); }
+		//unsupported kernels fall back to scalar, for benchmarks and comparing kernels
+		void cull(const Frustum& frustum, uint8_t* visible, uint32_t first, uint32_t range, CullKernel kernel) const;
+
+		static CullKernel best_kernel();
+		static bool kernel_supported(CullKernel kernel);
+	private:
+		uint32_t count = 0;
+		//padded to a multiple of 8, padding is never reported
+		std::vector<float> center_x, center_y, center_z;
+		std::vector<float> extent_x, extent_y, extent_z;
+	};
+}
+
+#endif // !CULLING_H
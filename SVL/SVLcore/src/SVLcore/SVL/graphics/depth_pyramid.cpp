@@ -0,0 +1,258 @@
+#include "depth_pyramid.h"
+#include "../common/ErrorHandler.h"
+
+#include <algorithm>
+
+#include "renderer.h"
+#include "descriptor.h"
+#include "pipeline.h"
+#include "tools.h"
+
+//push constants of the downsample shader
+struct DownsamplePushConstants
+{
+	uint32_t source_size[2];
+	uint32_t destination_size[2];
+};
+static const uint32_t downsample_group_size = 8;
+
+SVL::DepthPyramid::DepthPyramid(const Renderer& renderer, std::string downsample_shader_path)
+	: vk_renderer(renderer), depth(renderer), pyramid(renderer)
+{
+	VkFormat depth_format = SVLTools::find_supported_format(vk_renderer.physical_device(), { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	depth.format = depth_format;
+
+	VkAttachmentDescription attachment{};
+	attachment.format = depth_format;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	static const VkAttachmentReference depth_reference{ 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.pDepthStencilAttachment = &depth_reference;
+
+	//the previous build still samples the target, the next one samples what this pass writes
+	std::vector<VkSubpassDependency> dependencies(2);
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vk_render_pass = new RenderPass(vk_renderer, { attachment }, { subpass }, dependencies);
+
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_NEAREST;
+	sampler_info.minFilter = VK_FILTER_NEAREST;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+	vk_sampler = vk_renderer.pipelines().sampler(sampler_info);
+
+	//set0 binding0 - source, binding1 - destination level
+	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	PipelineRegistry& registry = vk_renderer.pipelines();
+	vk_descriptor_set_layout = registry.descriptor_set_layout(bindings);
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(DownsamplePushConstants);
+	vk_pipeline_layout = registry.pipeline_layout({ vk_descriptor_set_layout }, { push_constant_range });
+
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_info.stage.module = registry.shader_module(SVLTools::read_file(downsample_shader_path));
+	pipeline_info.stage.pName = "main";
+	pipeline_info.layout = vk_pipeline_layout;
+	ErrorCheck(vkCreateComputePipelines(vk_renderer.device(), vk_renderer.pipeline_cache(), 1, &pipeline_info, nullptr, &vk_pipeline));
+
+	vk_descriptor_allocator = new DescriptorAllocator(vk_renderer, { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }, { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 } });
+}
+SVL::DepthPyramid::~DepthPyramid()
+{
+	destroy();
+	delete vk_descriptor_allocator;
+	vkDestroyPipeline(vk_renderer.device(), vk_pipeline, nullptr);
+	delete vk_render_pass;
+}
+
+void SVL::DepthPyramid::resize(VkExtent2D extent)
+{
+	if (depth.image != VK_NULL_HANDLE && extent.width == depth.extent.width && extent.height == depth.extent.height)
+		return;
+	vk_renderer.wait_for_device();
+	destroy();
+	create(extent);
+}
+
+void SVL::DepthPyramid::create(VkExtent2D extent)
+{
+	extent.width = std::max(extent.width, 2u);
+	extent.height = std::max(extent.height, 2u);
+	depth.create_2D_image(extent, depth.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 1, 1);
+	depth.create_2D_image_view(VK_IMAGE_ASPECT_DEPTH_BIT);
+
+	VkFramebufferCreateInfo framebuffer_info{};
+	framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebuffer_info.renderPass = (*vk_render_pass)();
+	framebuffer_info.attachmentCount = 1;
+	framebuffer_info.pAttachments = &depth.view;
+	framebuffer_info.width = extent.width;
+	framebuffer_info.height = extent.height;
+	framebuffer_info.layers = 1;
+	ErrorCheck(vkCreateFramebuffer(vk_renderer.device(), &framebuffer_info, nullptr, &vk_framebuffer));
+
+	VkExtent2D pyramid_extent{ extent.width / 2, extent.height / 2 };
+	uint32_t levels = 1;
+	while ((std::max(pyramid_extent.width, pyramid_extent.height) >> levels) > 0)
+		levels++;
+	pyramid.create_2D_image(pyramid_extent, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 1, levels);
+	pyramid_view = SVLTools::create_2D_image_view(vk_renderer.device(), pyramid.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+	pyramid_initialized = false;
+
+	level_views.resize(levels);
+	level_sets.resize(levels);
+	for (uint32_t i = 0; i < levels; i++)
+	{
+		VkImageViewCreateInfo view_info{};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = pyramid.image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = VK_FORMAT_R32_SFLOAT;
+		view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+		ErrorCheck(vkCreateImageView(vk_renderer.device(), &view_info, nullptr, &level_views[i]));
+
+		VkDescriptorImageInfo source{ vk_sampler, i == 0 ? depth.view : level_views[i - 1], i == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo destination{ VK_NULL_HANDLE, level_views[i], VK_IMAGE_LAYOUT_GENERAL };
+		level_sets[i] = vk_descriptor_allocator->allocate(vk_descriptor_set_layout);
+
+		VkWriteDescriptorSet writes[2] = {};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = level_sets[i];
+		writes[0].dstBinding = 0;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].descriptorCount = 1;
+		writes[0].pImageInfo = &source;
+		writes[1] = writes[0];
+		writes[1].dstBinding = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo = &destination;
+		vkUpdateDescriptorSets(vk_renderer.device(), 2, writes, 0, nullptr);
+	}
+}
+
+void SVL::DepthPyramid::destroy()
+{
+	if (depth.image == VK_NULL_HANDLE) return;
+	for (uint32_t i = 0; i < level_views.size(); i++)
+	{
+		vk_descriptor_allocator->free(level_sets[i]);
+		vkDestroyImageView(vk_renderer.device(), level_views[i], nullptr);
+	}
+	level_sets.clear();
+	level_views.clear();
+	vkDestroyImageView(vk_renderer.device(), pyramid_view, nullptr);
+	pyramid.destroy();
+	pyramid.image = VK_NULL_HANDLE;
+	vkDestroyFramebuffer(vk_renderer.device(), vk_framebuffer, nullptr);
+	depth.destroy();
+	depth.image = VK_NULL_HANDLE;
+}
+
+void SVL::DepthPyramid::begin(VkCommandBuffer command_buffer)
+{
+	VkClearValue clear_value{};
+	clear_value.depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo render_pass_begin_info{};
+	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_begin_info.renderPass = (*vk_render_pass)();
+	render_pass_begin_info.framebuffer = vk_framebuffer;
+	render_pass_begin_info.renderArea.extent = depth.extent;
+	render_pass_begin_info.clearValueCount = 1;
+	render_pass_begin_info.pClearValues = &clear_value;
+	vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	VkViewport viewport{ 0.0f, 0.0f, (float)depth.extent.width, (float)depth.extent.height, 0.0f, 1.0f };
+	VkRect2D scissor{ { 0, 0 }, depth.extent };
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
+void SVL::DepthPyramid::end(VkCommandBuffer command_buffer)
+{
+	vkCmdEndRenderPass(command_buffer);
+}
+
+void SVL::DepthPyramid::prepare(VkCommandBuffer command_buffer)
+{
+	if (pyramid_initialized) return;
+	pyramid_initialized = true;
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pyramid.image;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.mip_levels, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void SVL::DepthPyramid::build(VkCommandBuffer command_buffer)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pyramid.image;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_pipeline);
+	VkExtent2D source = depth.extent;
+	for (uint32_t i = 0; i < pyramid.mip_levels; i++)
+	{
+		VkExtent2D destination{ std::max(pyramid.extent.width >> i, 1u), std::max(pyramid.extent.height >> i, 1u) };
+		DownsamplePushConstants push{ { source.width, source.height }, { destination.width, destination.height } };
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_pipeline_layout, 0, 1, &level_sets[i], 0, nullptr);
+		vkCmdPushConstants(command_buffer, vk_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsamplePushConstants), &push);
+		vkCmdDispatch(command_buffer, (destination.width + downsample_group_size - 1) / downsample_group_size, (destination.height + downsample_group_size - 1) / downsample_group_size, 1);
+
+		//the next level and the cull pass read this one
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		source = destination;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+
+#include "image.h"
+#include "render_pass.h"
+
+namespace SVL
+{
+	class Renderer;
+	class DescriptorAllocator;
+
+	//depth only target for occluders and its hierarchical max reduction, built by the compiled hiz.comp at downsample_shader_path
+	//level 0 is half the target size, every texel holds the farthest depth of the target texels it covers
+	class DLLDIR DepthPyramid
+	{
+	public:
+		DepthPyramid(const Renderer& renderer, std::string downsample_shader_path);
+		~DepthPyramid();
+
+		DepthPyramid(const DepthPyramid&) = delete;
+		DepthPyramid& operator=(const DepthPyramid&) = delete;
+		DepthPyramid(DepthPyramid&&) = delete;
+		DepthPyramid& operator=(DepthPyramid&&) = delete;
+
+		//recreates the target and the pyramid, waits for the device
+		void resize(VkExtent2D extent);
+		//moves a new pyramid to general layout, call before anything of the frame binds it
+		void prepare(VkCommandBuffer command_buffer);
+
+		//depth only render pass into the target, cleared to the far plane, viewport and scissor are set
+		void begin(VkCommandBuffer command_buffer);
+		void end(VkCommandBuffer command_buffer);
+		//reduces the target into every level, compute reads after it are synchronized
+		void build(VkCommandBuffer command_buffer);
+
+		const RenderPass& render_pass() const { return *vk_render_pass; }
+		const VkExtent2D target_extent() const { return depth.extent; }
+		//all levels, general layout
+		const VkImageView view() const { return pyramid_view; }
+		const VkExtent2D extent() const { return pyramid.extent; }
+		const uint32_t levels() const { return pyramid.mip_levels; }
+	private:
+		const class Renderer& vk_renderer;
+
+		RenderPass* vk_render_pass = nullptr;
+		ImageView depth;
+		VkFramebuffer vk_framebuffer = VK_NULL_HANDLE;
+
+		Image pyramid;
+		VkImageView pyramid_view = VK_NULL_HANDLE;
+		std::vector<VkImageView> level_views;
+		std::vector<VkDescriptorSet> level_sets; //source - previous level or the target, destination - the level
+		bool pyramid_initialized = false;
+
+		VkSampler vk_sampler = VK_NULL_HANDLE; //from the pipeline registry
+		DescriptorAllocator* vk_descriptor_allocator = nullptr;
+		VkDescriptorSetLayout vk_descriptor_set_layout = VK_NULL_HANDLE;
+		VkPipelineLayout vk_pipeline_layout = VK_NULL_HANDLE;
+		VkPipeline vk_pipeline = VK_NULL_HANDLE;
+
+		void create(VkExtent2D extent);
+		void destroy();
+	};
+}
+
+#endif // !DEPTH_PYRAMID_H
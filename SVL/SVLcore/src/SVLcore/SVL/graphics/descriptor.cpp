@@ -0,0 +1,80 @@
+#include "descriptor.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include "renderer.h"
+
+SVL::DescriptorAllocator::DescriptorAllocator(const Renderer& renderer, std::vector<VkDescriptorPoolSize> set_sizes, uint32_t sets_per_pool)
+	: vk_renderer(renderer), sets_per_pool(sets_per_pool), pool_sizes(set_sizes)
+{
+	for (VkDescriptorPoolSize& size : pool_sizes)
+		size.descriptorCount *= sets_per_pool;
+}
+
+SVL::DescriptorAllocator::~DescriptorAllocator()
+{
+	for (Pool& pool : pools)
+		vkDestroyDescriptorPool(vk_renderer.device(), pool.pool, nullptr);
+}
+
+VkDescriptorSet SVL::DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	VkDescriptorSetAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocate_info.descriptorSetCount = 1;
+	allocate_info.pSetLayouts = &layout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	for (uint32_t i = 0; i < pools.size(); i++)
+	{
+		if (pools[i].allocated == sets_per_pool)
+			continue;
+		allocate_info.descriptorPool = pools[i].pool;
+		VkResult result = vkAllocateDescriptorSets(vk_renderer.device(), &allocate_info, &set);
+		//freed sets can leave a pool fragmented, try the next one
+		if (result == VK_ERROR_FRAGMENTED_POOL || result == VK_ERROR_OUT_OF_POOL_MEMORY)
+			continue;
+		ErrorCheck(result);
+
+		pools[i].allocated++;
+		owners[set] = i;
+		return set;
+	}
+
+	create_pool();
+	allocate_info.descriptorPool = pools.back().pool;
+	ErrorCheck(vkAllocateDescriptorSets(vk_renderer.device(), &allocate_info, &set));
+	pools.back().allocated++;
+	owners[set] = (uint32_t)pools.size() - 1;
+	return set;
+}
+
+void SVL::DescriptorAllocator::free(VkDescriptorSet& set)
+{
+	if (set == VK_NULL_HANDLE)
+		return;
+
+	auto owner = owners.find(set);
+	if (owner == owners.end())
+		Error("SVL ERROR: descriptor set was not allocated by this allocator.");
+
+	Pool& pool = pools[owner->second];
+	ErrorCheck(vkFreeDescriptorSets(vk_renderer.device(), pool.pool, 1, &set));
+	pool.allocated--;
+	owners.erase(owner);
+	set = VK_NULL_HANDLE;
+}
+
+void SVL::DescriptorAllocator::create_pool()
+{
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	pool_info.poolSizeCount = pool_sizes.size();
+	pool_info.pPoolSizes = pool_sizes.data();
+	pool_info.maxSets = sets_per_pool;
+
+	Pool pool;
+	pool.allocated = 0;
+	ErrorCheck(vkCreateDescriptorPool(vk_renderer.device(), &pool_info, nullptr, &pool.pool));
+	pools.push_back(pool);
+}
@@ -0,0 +1,49 @@
+#ifndef DESCRIPTOR_H
+#define DESCRIPTOR_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <unordered_map>
+
+namespace SVL
+{
+	class Renderer;
+	//hands out individually freeable descriptor sets, a new pool is added whenever the existing ones are full
+	class DLLDIR DescriptorAllocator
+	{
+	public:
+		//set_sizes is the largest number of descriptors of each type a single set may use
+		DescriptorAllocator(const Renderer& renderer, std::vector<VkDescriptorPoolSize> set_sizes, uint32_t sets_per_pool = DESCRIPTOR_POOL_SETS);
+		~DescriptorAllocator();
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+		DescriptorAllocator(DescriptorAllocator&&) = delete;
+		DescriptorAllocator& operator=(DescriptorAllocator&&) = delete;
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+		//the set must not be used by pending command buffers
+		void free(VkDescriptorSet& set);
+
+		const uint32_t pool_count() const { return (uint32_t)pools.size(); }
+	private:
+		struct Pool
+		{
+			VkDescriptorPool pool;
+			uint32_t allocated;
+		};
+
+		const class Renderer& vk_renderer;
+		const uint32_t sets_per_pool;
+		std::vector<VkDescriptorPoolSize> pool_sizes;
+
+		std::vector<Pool> pools;
+		std::unordered_map<VkDescriptorSet, uint32_t> owners;
+
+		void create_pool();
+	};
+}
+
+#endif // !DESCRIPTOR_H
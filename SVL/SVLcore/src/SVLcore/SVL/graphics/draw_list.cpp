@@ -0,0 +1,170 @@
+#include "draw_list.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "model.h"
+
+//key layout, from the most significant bits
+static const uint32_t pipeline_bits = 8;
+static const uint32_t material_bits = 20;
+static const uint32_t buffer_bits = 16;
+static const uint32_t depth_bits = 20;
+
+template<typename T>
+static uint64_t state_id(std::unordered_map<T, uint32_t>& ids, T handle, uint32_t bits)
+{
+	//ids past the field only lose their sort order
+	uint32_t id = ids.emplace(handle, (uint32_t)ids.size()).first->second;
+	return std::min<uint64_t>(id, (1ull << bits) - 1);
+}
+
+void SVL::DrawList::clear()
+{
+	draws.clear();
+	pipeline_ids.clear();
+	material_ids.clear();
+	buffer_ids.clear();
+}
+
+void SVL::DrawList::add(const Draw& draw)
+{
+	draws.push_back(draw);
+}
+
+void SVL::DrawList::sort()
+{
+	uint32_t count = (uint32_t)draws.size();
+	keys.resize(count);
+	order.resize(count);
+	scratch_keys.resize(count);
+	scratch_order.resize(count);
+
+	float max_depth = 0.0f;
+	for (const Draw& draw : draws)
+		max_depth = std::max(max_depth, draw.depth);
+	float depth_scale = max_depth > 0.0f ? (float)((1u << depth_bits) - 1) / max_depth : 0.0f;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Draw& draw = draws[i];
+		uint64_t key = state_id(pipeline_ids, draw.pipeline, pipeline_bits);
+		key = (key << material_bits) | state_id(material_ids, draw.material, material_bits);
+		key = (key << buffer_bits) | state_id(buffer_ids, draw.vertices, buffer_bits);
+		key = (key << depth_bits) | (uint64_t)(std::max(draw.depth, 0.0f) * depth_scale);
+		keys[i] = key;
+		order[i] = i;
+	}
+	if (count == 0) return;
+
+	//lsd radix sort by bytes, stable so equal keys keep their insertion order
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		uint32_t offsets[256] = {};
+		for (uint32_t i = 0; i < count; i++)
+			offsets[(keys[i] >> shift) & 0xff]++;
+		//all keys share this byte
+		if (offsets[(keys[0] >> shift) & 0xff] == count) continue;
+
+		uint32_t sum = 0;
+		for (uint32_t& offset : offsets)
+		{
+			uint32_t bucket = offset;
+			offset = sum;
+			sum += bucket;
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t slot = offsets[(keys[i] >> shift) & 0xff]++;
+			scratch_keys[slot] = keys[i];
+			scratch_order[slot] = order[i];
+		}
+		keys.swap(scratch_keys);
+		order.swap(scratch_order);
+	}
+}
+
+SVL::DrawList::Stats SVL::DrawList::record(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, bool push_constants) const
+{
+	Stats stats;
+	stats.draws = (uint32_t)order.size();
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkDescriptorSet material = VK_NULL_HANDLE;
+	VkDescriptorSet object = VK_NULL_HANDLE;
+	uint32_t object_offset = 0;
+	VkBuffer vertices = VK_NULL_HANDLE;
+	VkBuffer instances = VK_NULL_HANDLE;
+	VkDeviceSize instances_offset = 0;
+	VkBuffer indices = VK_NULL_HANDLE;
+	const Model* pushed_model = nullptr;
+	uint32_t pushed_material = UINT32_MAX;
+
+	for (uint32_t i : order)
+	{
+		const Draw& draw = draws[i];
+		uint32_t binds = stats.binds;
+
+		if (draw.pipeline != pipeline)
+		{
+			pipeline = draw.pipeline;
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			stats.binds++;
+		}
+		if (draw.vertices != vertices || draw.instances != instances || draw.instances_offset != instances_offset)
+		{
+			vertices = draw.vertices;
+			instances = draw.instances;
+			instances_offset = draw.instances_offset;
+			VkBuffer vertex_buffers[] = { vertices, instances };
+			VkDeviceSize offsets[] = { 0, instances_offset };
+			vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+			stats.binds++;
+		}
+		if (draw.indices != indices)
+		{
+			indices = draw.indices;
+			vkCmdBindIndexBuffer(command_buffer, indices, 0, VK_INDEX_TYPE_UINT32);
+			stats.binds++;
+		}
+		if (draw.material != VK_NULL_HANDLE && draw.material != material)
+		{
+			material = draw.material;
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 1, &material, 0, nullptr);
+			stats.binds++;
+		}
+		if (push_constants)
+		{
+			if (draw.model != pushed_model || draw.material_index != pushed_material)
+			{
+				pushed_model = draw.model;
+				pushed_material = draw.material_index;
+				ObjectPushConstants push{};
+				push.model = pushed_model->ubo_model();
+				push.material_index = pushed_material;
+				vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectPushConstants), &push);
+				stats.binds++;
+			}
+		}
+		else
+		{
+			if (draw.material == VK_NULL_HANDLE && draw.material_index != pushed_material)
+			{
+				pushed_material = draw.material_index;
+				vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, offsetof(ObjectPushConstants, material_index), sizeof(uint32_t), &pushed_material);
+				stats.binds++;
+			}
+			if (draw.object != object || draw.object_offset != object_offset)
+			{
+				object = draw.object;
+				object_offset = draw.object_offset;
+				vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 2, 1, &object, 1, &object_offset);
+				stats.binds++;
+			}
+		}
+		stats.redundant_binds += 5 - (stats.binds - binds);
+
+		vkCmdDrawIndexed(command_buffer, draw.index_count, draw.instance_count, draw.first_index, draw.vertex_offset, 0);
+	}
+	return stats;
+}
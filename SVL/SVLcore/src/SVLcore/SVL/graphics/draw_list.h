@@ -0,0 +1,66 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace SVL
+{
+	class Model;
+
+	//draws of a command buffer sorted by state, recorded with only the binds that differ from the previous draw
+	//sort keys hold pipeline, material, vertex buffer and depth from the most to the least significant bits
+	class DLLDIR DrawList
+	{
+	public:
+		struct Draw
+		{
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkDescriptorSet material = VK_NULL_HANDLE; //set 1, null for bindless materials selected by material_index
+			VkDescriptorSet object = VK_NULL_HANDLE; //set 2, unused with push constants
+			uint32_t object_offset = 0;
+			VkBuffer vertices = VK_NULL_HANDLE; //binding 0
+			VkBuffer instances = VK_NULL_HANDLE; //binding 1
+			VkDeviceSize instances_offset = 0;
+			VkBuffer indices = VK_NULL_HANDLE;
+			uint32_t index_count = 0;
+			uint32_t instance_count = 0;
+			uint32_t first_index = 0;
+			int32_t vertex_offset = 0;
+			const Model* model = nullptr; //transform source with push constants
+			uint32_t material_index = 0; //pushed with the transform, or alone for bindless materials
+			float depth = 0.0f; //view space distance, nearer draws first among equal state
+		};
+		struct Stats
+		{
+			uint32_t draws = 0;
+			uint32_t binds = 0; //pipeline, descriptor set and buffer binds and pushes recorded
+			uint32_t redundant_binds = 0; //skipped since the previous draw had the same state, every draw binds 5 states otherwise
+		};
+
+		void clear();
+		void add(const Draw& draw);
+		//radix sort of the keys, ids are handed out in order of first appearance since the last clear
+		void sort();
+		//expects the scene set bound, push_constants - transform and material index are pushed instead of binding set 2
+		Stats record(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, bool push_constants) const;
+
+		const uint32_t size() const { return (uint32_t)draws.size(); }
+	private:
+		std::vector<Draw> draws;
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> order;
+		std::vector<uint64_t> scratch_keys;
+		std::vector<uint32_t> scratch_order;
+
+		std::unordered_map<VkPipeline, uint32_t> pipeline_ids;
+		std::unordered_map<VkDescriptorSet, uint32_t> material_ids;
+		std::unordered_map<VkBuffer, uint32_t> buffer_ids;
+	};
+}
+
+#endif // !DRAW_LIST_H
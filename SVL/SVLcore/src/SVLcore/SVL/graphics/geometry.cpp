@@ -0,0 +1,134 @@
+#include "geometry.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include <algorithm>
+
+#include "renderer.h"
+#include "upload.h"
+#include "tools.h"
+
+SVL::GeometryPool::GeometryPool(const Renderer& renderer, uint32_t vertices_per_page, uint32_t indices_per_page)
+	: vk_renderer(renderer), vertices_per_page(vertices_per_page), indices_per_page(indices_per_page)
+{
+}
+
+SVL::GeometryPool::~GeometryPool()
+{
+	for (Page& page : pages)
+	{
+		SVLTools::destroy_buffer(vk_renderer, page.indices, page.index_allocation);
+		SVLTools::destroy_buffer(vk_renderer, page.vertices, page.vertex_allocation);
+	}
+}
+
+SVL::GeometryPool::Range SVL::GeometryPool::allocate(UploadBatch& upload, const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& indices)
+{
+	Range range;
+	if (vertices.empty() || indices.empty())
+		return range;
+	range.vertex_count = (uint32_t)vertices.size();
+	range.index_count = (uint32_t)indices.size();
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for (uint32_t i = 0; i < pages.size() && range.page == UINT32_MAX; i++)
+	{
+		Page& page = pages[i];
+		if (!try_allocate(page.free_vertices, range.vertex_count, range.first_vertex))
+			continue;
+		if (!try_allocate(page.free_indices, range.index_count, range.first_index))
+		{
+			release(page.free_vertices, range.first_vertex, range.vertex_count);
+			continue;
+		}
+		range.page = i;
+	}
+	if (range.page == UINT32_MAX)
+	{
+		Page page;
+		uint32_t page_vertices = std::max(vertices_per_page, range.vertex_count);
+		uint32_t page_indices = std::max(indices_per_page, range.index_count);
+		SVLTools::create_buffer(vk_renderer, (VkDeviceSize)page_vertices * sizeof(Vertex3D), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &page.vertices, &page.vertex_allocation);
+		SVLTools::create_buffer(vk_renderer, (VkDeviceSize)page_indices * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &page.indices, &page.index_allocation);
+		if (page_vertices > range.vertex_count)
+			page.free_vertices.push_back({ range.vertex_count, page_vertices - range.vertex_count });
+		if (page_indices > range.index_count)
+			page.free_indices.push_back({ range.index_count, page_indices - range.index_count });
+		pages.push_back(page);
+		range.page = (uint32_t)pages.size() - 1;
+		range.first_vertex = 0;
+		range.first_index = 0;
+	}
+	VkBuffer vertex_buffer = pages[range.page].vertices;
+	VkBuffer index_buffer = pages[range.page].indices;
+	lock.unlock();
+
+	upload.copy_buffer(vertices.data(), (VkDeviceSize)range.vertex_count * sizeof(Vertex3D), vertex_buffer, (VkDeviceSize)range.first_vertex * sizeof(Vertex3D));
+	upload.copy_buffer(indices.data(), (VkDeviceSize)range.index_count * sizeof(uint32_t), index_buffer, (VkDeviceSize)range.first_index * sizeof(uint32_t));
+	return range;
+}
+
+void SVL::GeometryPool::free(Range& range)
+{
+	if (range.page == UINT32_MAX)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Page& page = pages[range.page];
+	release(page.free_vertices, range.first_vertex, range.vertex_count);
+	release(page.free_indices, range.first_index, range.index_count);
+	range = Range();
+}
+
+const VkBuffer SVL::GeometryPool::vertex_buffer(uint32_t page) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pages[page].vertices;
+}
+
+const VkBuffer SVL::GeometryPool::index_buffer(uint32_t page) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pages[page].indices;
+}
+
+const uint32_t SVL::GeometryPool::pages_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (uint32_t)pages.size();
+}
+
+bool SVL::GeometryPool::try_allocate(std::vector<Span>& spans, uint32_t size, uint32_t& offset)
+{
+	//first fit, ranges are only ever split and merged by offset
+	for (size_t i = 0; i < spans.size(); i++)
+	{
+		if (spans[i].size < size)
+			continue;
+		offset = spans[i].offset;
+		spans[i].offset += size;
+		spans[i].size -= size;
+		if (spans[i].size == 0)
+			spans.erase(spans.begin() + i);
+		return true;
+	}
+	return false;
+}
+
+void SVL::GeometryPool::release(std::vector<Span>& spans, uint32_t offset, uint32_t size)
+{
+	//insert and merge with neighbours
+	Span span{ offset, size };
+	auto it = std::lower_bound(spans.begin(), spans.end(), span, [](const Span& a, const Span& b) { return a.offset < b.offset; });
+	it = spans.insert(it, span);
+	if (it + 1 != spans.end() && it->offset + it->size == (it + 1)->offset)
+	{
+		it->size += (it + 1)->size;
+		spans.erase(it + 1);
+	}
+	if (it != spans.begin() && (it - 1)->offset + (it - 1)->size == it->offset)
+	{
+		(it - 1)->size += it->size;
+		spans.erase(it);
+	}
+}
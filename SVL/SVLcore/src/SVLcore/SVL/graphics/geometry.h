@@ -0,0 +1,75 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+
+#include "memory.h"
+#include "vertex.h"
+
+namespace SVL
+{
+	class Renderer;
+	class UploadBatch;
+	//renderer wide vertex and index buffers, models take ranges of them instead of buffers of their own
+	//a page holds vertices_per_page vertices and indices_per_page indices, larger requests get a page sized for them
+	class DLLDIR GeometryPool
+	{
+	public:
+		struct Range
+		{
+			uint32_t page = UINT32_MAX;
+			uint32_t first_vertex = 0; //vertex offset of draws
+			uint32_t vertex_count = 0;
+			uint32_t first_index = 0;
+			uint32_t index_count = 0;
+		};
+
+		GeometryPool(const Renderer& renderer, uint32_t vertices_per_page = GEOMETRY_POOL_VERTICES, uint32_t indices_per_page = GEOMETRY_POOL_INDICES);
+		~GeometryPool();
+
+		GeometryPool(const GeometryPool&) = delete;
+		GeometryPool& operator=(const GeometryPool&) = delete;
+		GeometryPool(GeometryPool&&) = delete;
+		GeometryPool& operator=(GeometryPool&&) = delete;
+
+		//copies the geometry through upload, empty geometry gets an empty range on no page
+		Range allocate(UploadBatch& upload, const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& indices);
+		//the range must no longer be used by frames in flight
+		void free(Range& range);
+
+		//pages are never destroyed or moved, ranges of one page share a single vertex and index buffer binding
+		const VkBuffer vertex_buffer(uint32_t page) const;
+		const VkBuffer index_buffer(uint32_t page) const;
+		const uint32_t pages_count() const;
+	private:
+		struct Span
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+		struct Page
+		{
+			VkBuffer vertices = VK_NULL_HANDLE;
+			Allocation vertex_allocation;
+			VkBuffer indices = VK_NULL_HANDLE;
+			Allocation index_allocation;
+			std::vector<Span> free_vertices; //sorted by offset
+			std::vector<Span> free_indices;
+		};
+
+		const class Renderer& vk_renderer;
+		const uint32_t vertices_per_page;
+		const uint32_t indices_per_page;
+		std::vector<Page> pages;
+		mutable std::mutex mutex;
+
+		static bool try_allocate(std::vector<Span>& spans, uint32_t size, uint32_t& offset);
+		static void release(std::vector<Span>& spans, uint32_t offset, uint32_t size);
+	};
+}
+
+#endif // !GEOMETRY_H
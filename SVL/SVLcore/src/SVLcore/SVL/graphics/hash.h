@@ -0,0 +1,45 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace SVL
+{
+	//64 bit fnv-1a, feed structs with padding field by field so the padding never gets hashed
+	class Hasher
+	{
+	public:
+		Hasher& add(const void* data, size_t size)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++)
+			{
+				vk_hash ^= bytes[i];
+				vk_hash *= 1099511628211ull;
+			}
+			return *this;
+		}
+		template<typename T>
+		Hasher& add(const T& value) { return add(&value, sizeof(T)); }
+		template<typename T>
+		Hasher& add(const std::vector<T>& values)
+		{
+			add((uint64_t)values.size());
+			return add(values.data(), values.size() * sizeof(T));
+		}
+		Hasher& add(const std::string& value)
+		{
+			add((uint64_t)value.size());
+			return add(value.data(), value.size());
+		}
+
+		const uint64_t value() const { return vk_hash; }
+	private:
+		uint64_t vk_hash = 14695981039346656037ull;
+	};
+}
+
+#endif // !HASH_H
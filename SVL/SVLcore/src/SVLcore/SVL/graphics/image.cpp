@@ -2,11 +2,12 @@
 
 #include <SVL/common/ErrorHandler.h>
 #include "renderer.h"
+#include "memory.h"
 #include "window.h"
 #include <SVL/graphics/tools.h>
 
 SVL::Image::Image(Image&& i)
-	: image(std::move(i.image)), memory(std::move(i.memory)), vk_renderer(i.vk_renderer), extent(std::move(i.extent)), format(std::move(i.format)), samples(std::move(i.samples)), layout(std::move(i.layout)), array_layers(std::move(i.array_layers)), mip_levels(std::move(i.mip_levels))
+	: image(std::move(i.image)), memory(std::move(i.memory)), allocation(std::move(i.allocation)), vk_renderer(i.vk_renderer), extent(std::move(i.extent)), format(std::move(i.format)), samples(std::move(i.samples)), layout(std::move(i.layout)), array_layers(std::move(i.array_layers)), mip_levels(std::move(i.mip_levels))
 {
 }
 
@@ -16,8 +17,9 @@ SVL::Image::~Image()
 
 void SVL::Image::destroy()
 {
-	vkFreeMemory(vk_renderer.device(), memory, nullptr);
 	vkDestroyImage(vk_renderer.device(), image, nullptr);
+	vk_renderer.allocator().free(allocation);
+	memory = VK_NULL_HANDLE;
 }
 
 SVL::ImageView::ImageView(ImageView&& i)
@@ -62,12 +64,9 @@ void SVL::Image::create_2D_image(VkExtent2D extent, VkFormat format, VkImageTili
 	VkMemoryRequirements memory_requirements;
 	vkGetImageMemoryRequirements(vk_renderer.device(), image, &memory_requirements);
 
-	VkMemoryAllocateInfo allocate_info = {};
-	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocate_info.allocationSize = memory_requirements.size;
-	allocate_info.memoryTypeIndex = SVLTools::find_memory_type(vk_renderer.physical_device(), memory_requirements.memoryTypeBits, properties);
-	ErrorCheck(vkAllocateMemory(vk_renderer.device(), &allocate_info, nullptr, &memory));
-	ErrorCheck(vkBindImageMemory(vk_renderer.device(), image, memory, 0));
+	allocation = vk_renderer.allocator().allocate(memory_requirements, properties, tiling == VK_IMAGE_TILING_LINEAR);
+	vk_renderer.allocator().bind_image(image, allocation);
+	memory = allocation.memory;
 }
 
 void SVL::Image::copy_buffer_to_image(VkCommandPool command_pool, VkBuffer buffer, std::vector<VkBufferImageCopy> buffer_copy_regions)
@@ -77,12 +76,14 @@ void SVL::Image::copy_buffer_to_image(VkCommandPool command_pool, VkBuffer buffe
 
 	vkCmdCopyBufferToImage(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, buffer_copy_regions.size(), buffer_copy_regions.data());
 
+	std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.queue()));
 	SVLTools::end_single_time_commands(vk_renderer.device(), vk_renderer.queue(), command_pool, command_buffer);
 }
 
-void SVL::Image::copy_buffer_to_image(VkCommandPool command_pool, VkBuffer buffer, VkImageAspectFlags aspect)
+void SVL::Image::copy_buffer_to_image(VkCommandPool command_pool, VkBuffer buffer, VkImageAspectFlags aspect, VkDeviceSize buffer_offset)
 {
 	VkBufferImageCopy buffer_copy_region{};
+	buffer_copy_region.bufferOffset = buffer_offset;
 	buffer_copy_region.imageSubresource.aspectMask = aspect;
 	buffer_copy_region.imageSubresource.mipLevel = 0;
 	buffer_copy_region.imageSubresource.baseArrayLayer = 0;
@@ -101,6 +102,7 @@ void SVL::Image::copy_image_to_buffer(VkCommandPool command_pool, VkBuffer& buff
 
 	vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, buffer_copy_regions.size(), buffer_copy_regions.data());
 
+	std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.queue()));
 	SVLTools::end_single_time_commands(vk_renderer.device(), vk_renderer.queue(), command_pool, command_buffer);
 }
 
@@ -119,6 +121,15 @@ void SVL::Image::copy_image_to_buffer(VkCommandPool command_pool, VkBuffer& buff
 }
 
 void SVL::Image::transition_image_layout(VkCommandPool command_pool, VkImageLayout new_layout, VkImageAspectFlags aspect)
+{
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+	SVLTools::begin_single_time_commands(vk_renderer.device(), command_pool, command_buffer);
+	transition_image_layout(command_buffer, new_layout, aspect);
+	std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.queue()));
+	SVLTools::end_single_time_commands(vk_renderer.device(), vk_renderer.queue(), command_pool, command_buffer);
+}
+
+void SVL::Image::transition_image_layout(VkCommandBuffer command_buffer, VkImageLayout new_layout, VkImageAspectFlags aspect)
 {
 	if (image == VK_NULL_HANDLE || memory == VK_NULL_HANDLE)
 		Error("transition_image_layout - null image or memory!");
@@ -129,8 +140,6 @@ void SVL::Image::transition_image_layout(VkCommandPool command_pool, VkImageLayo
 	subresource_range.levelCount = mip_levels;
 	subresource_range.layerCount = array_layers;
 
-	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
-	SVLTools::begin_single_time_commands(vk_renderer.device(), command_pool, command_buffer);
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = layout;
@@ -195,12 +204,11 @@ void SVL::Image::transition_image_layout(VkCommandPool command_pool, VkImageLayo
 	}
 
 	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-	SVLTools::end_single_time_commands(vk_renderer.device(), vk_renderer.queue(), command_pool, command_buffer);
 
 	layout = new_layout;
 }
 
-void SVL::ImageView::create_2D_image_view(VkImageAspectFlags aspect)
+void SVL::ImageView::create_2D_image_view(VkImageAspectFlags aspect, VkComponentMapping components)
 {
 	this->aspect = aspect;
 
@@ -211,7 +219,7 @@ void SVL::ImageView::create_2D_image_view(VkImageAspectFlags aspect)
 	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	view_info.image = image;
 	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	view_info.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+	view_info.components = components;
 	view_info.format = format;
 	view_info.subresourceRange.aspectMask = aspect;
 	view_info.subresourceRange.baseMipLevel = 0;
@@ -5,6 +5,8 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 
+#include "memory.h"
+
 namespace SVL
 {
 	class Renderer;
@@ -21,15 +23,17 @@ namespace SVL
 
 		void create_2D_image(VkExtent2D extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkSampleCountFlagBits samples, VkMemoryPropertyFlags properties, VkImageLayout image_layout, uint32_t array_layers, uint32_t mip_levels, VkImageCreateFlags image_flags = VK_NULL_HANDLE);
 		void copy_buffer_to_image(VkCommandPool command_pool, VkBuffer buffer, std::vector<VkBufferImageCopy>);
-		void copy_buffer_to_image(VkCommandPool command_pool, VkBuffer buffer, VkImageAspectFlags aspect);
+		void copy_buffer_to_image(VkCommandPool command_pool, VkBuffer buffer, VkImageAspectFlags aspect, VkDeviceSize buffer_offset = 0);
 		void copy_image_to_buffer(VkCommandPool command_pool, VkBuffer& buffer, std::vector<VkBufferImageCopy>);
 		void copy_image_to_buffer(VkCommandPool command_pool, VkBuffer& buffer, VkImageAspectFlags aspect);
 		void transition_image_layout(VkCommandPool command_pool, VkImageLayout new_layout, VkImageAspectFlags aspect);
+		void transition_image_layout(VkCommandBuffer command_buffer, VkImageLayout new_layout, VkImageAspectFlags aspect);
 
 		void destroy();
 
 		VkImage image = VK_NULL_HANDLE;
 		VkDeviceMemory memory = VK_NULL_HANDLE;
+		Allocation allocation;
 
 		VkExtent2D extent;
 		VkFormat format;
@@ -52,7 +56,8 @@ namespace SVL
 		ImageView(const Renderer& r) : Image(r) {}
 		~ImageView();
 
-		void create_2D_image_view(VkImageAspectFlags aspect);
+		//components swizzle what shaders read, block compressed textures move their channels back in place
+		void create_2D_image_view(VkImageAspectFlags aspect, VkComponentMapping components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A });
 		void create_cube_image_view(VkImageAspectFlags aspect);
 
 		void destroy();
@@ -0,0 +1,448 @@
+#include "indirect.h"
+#include "../common/ErrorHandler.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "renderer.h"
+#include "model.h"
+#include "descriptor.h"
+#include "pipeline.h"
+#include "tools.h"
+#include "geometry.h"
+#include "depth_pyramid.h"
+
+//push constants of the cull shader
+struct CullPushConstants
+{
+	glm::vec4 planes[6];
+	uint32_t draw_count;
+	uint32_t phase; //0 - early records, 1 - all records
+	uint32_t capacity;
+	uint32_t batch_capacity;
+};
+//per frame, set0 binding6
+struct OcclusionUniforms
+{
+	glm::mat4 view_projection;
+	glm::vec4 pyramid; //level 0 width, height, levels, 0 levels disable the test
+};
+static const uint32_t cull_group_size = 64;
+static const uint32_t min_capacity = 64; //keeps every slice offset a multiple of 256 bytes
+
+static uint32_t grow_capacity(uint32_t capacity, uint32_t required)
+{
+	if (capacity == 0)
+		capacity = min_capacity;
+	while (capacity < required)
+		capacity *= 2;
+	return capacity;
+}
+
+bool SVL::IndirectDraws::supported(const Renderer& renderer)
+{
+	return renderer.features().drawIndirectFirstInstance == VK_TRUE;
+}
+
+SVL::IndirectDraws::IndirectDraws(const Renderer& renderer, std::string cull_shader_path)
+	: vk_renderer(renderer), compact(renderer.draw_indexed_indirect_count() != nullptr), placeholder(renderer)
+{
+	//set0 binding0 - draws, binding1 - transforms, binding2 - commands, binding3 - counts, binding4 - visibility
+	//binding5 - depth pyramid, binding6 - occlusion uniforms
+	std::vector<VkDescriptorSetLayoutBinding> bindings(7);
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+	bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	PipelineRegistry& registry = vk_renderer.pipelines();
+	vk_descriptor_set_layout = registry.descriptor_set_layout(bindings);
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(CullPushConstants);
+	vk_pipeline_layout = registry.pipeline_layout({ vk_descriptor_set_layout }, { push_constant_range });
+
+	//constant 0 - compact, commands are appended per batch and counted
+	VkBool32 compact_commands = compact ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry specialization_entry{ 0, 0, sizeof(VkBool32) };
+	VkSpecializationInfo specialization{ 1, &specialization_entry, sizeof(VkBool32), &compact_commands };
+
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_info.stage.module = registry.shader_module(SVLTools::read_file(cull_shader_path));
+	pipeline_info.stage.pName = "main";
+	pipeline_info.stage.pSpecializationInfo = &specialization;
+	pipeline_info.layout = vk_pipeline_layout;
+	ErrorCheck(vkCreateComputePipelines(vk_renderer.device(), vk_renderer.pipeline_cache(), 1, &pipeline_info, nullptr, &vk_pipeline));
+
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_NEAREST;
+	sampler_info.minFilter = VK_FILTER_NEAREST;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+	vk_sampler = vk_renderer.pipelines().sampler(sampler_info);
+
+	//never sampled, the occlusion uniforms disable the test without a pyramid
+	placeholder.create_2D_image({ 1, 1 }, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 1, 1);
+	placeholder_view = SVLTools::create_2D_image_view(vk_renderer.device(), placeholder.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	occlusion_slot = vk_renderer.uniforms().allocate(sizeof(OcclusionUniforms));
+
+	vk_descriptor_allocator = new DescriptorAllocator(vk_renderer, { { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 }, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }, { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 } }, vk_renderer.frames_in_flight());
+	frames.resize(vk_renderer.frames_in_flight());
+	VkDescriptorBufferInfo occlusion_info{ occlusion_slot.buffer, 0, occlusion_slot.size };
+	for (Frame& frame : frames)
+	{
+		frame.descriptor_set = vk_descriptor_allocator->allocate(vk_descriptor_set_layout);
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = frame.descriptor_set;
+		write.dstBinding = 6;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &occlusion_info;
+		vkUpdateDescriptorSets(vk_renderer.device(), 1, &write, 0, nullptr);
+	}
+	write_pyramid();
+}
+SVL::IndirectDraws::~IndirectDraws()
+{
+	destroy_buffers();
+	for (Frame& frame : frames)
+		vk_descriptor_allocator->free(frame.descriptor_set);
+	delete vk_descriptor_allocator;
+	vk_renderer.uniforms().free(occlusion_slot);
+	vkDestroyImageView(vk_renderer.device(), placeholder_view, nullptr);
+	placeholder.destroy();
+	vkDestroyPipeline(vk_renderer.device(), vk_pipeline, nullptr);
+}
+
+void SVL::IndirectDraws::build(const std::vector<Model*>& models)
+{
+	this->models = models;
+	layout();
+}
+
+void SVL::IndirectDraws::layout()
+{
+	records.clear();
+	batches.clear();
+	model_records.assign(models.size(), {});
+	draw_revisions.resize(models.size());
+
+	//one batch per material of every model, records of a batch are consecutive
+	//models sharing a geometry pool page are laid out together, so pages are bound once
+	std::vector<uint32_t> order(models.size());
+	for (uint32_t m = 0; m < models.size(); m++)
+		order[m] = m;
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return models[a]->geometry().page < models[b]->geometry().page; });
+
+	for (uint32_t m : order)
+	{
+		Model* model = models[m];
+		draw_revisions[m] = model->draw_revision();
+		const GeometryPool::Range& geometry = model->geometry();
+		if (!model->can_render() || geometry.page == UINT32_MAX) continue;
+
+		const std::vector<Mesh>& meshes = model->get_meshes();
+		std::vector<Material>& materials = model->get_materials();
+		uint32_t instances = model->instances_count();
+		for (uint32_t material = 0; material < materials.size(); material++)
+		{
+			Batch batch{ materials[material].vk_descriptor_set, materials[material].bindless_index, geometry.page, (uint32_t)records.size(), 0 };
+			for (const Mesh& mesh : meshes)
+			{
+				if (mesh.material_id != material) continue;
+				for (uint32_t instance = 0; instance < instances; instance++)
+				{
+					Record record{};
+					record.draw.bounds_min = glm::vec4(mesh.bounds_min, 1.0f);
+					record.draw.bounds_max = glm::vec4(mesh.bounds_max, 1.0f);
+					record.draw.index_count = (uint32_t)mesh.indices.size();
+					record.draw.first_index = geometry.first_index + (uint32_t)mesh.index_base;
+					record.draw.vertex_offset = (int32_t)(geometry.first_vertex + mesh.vertex_base);
+					record.draw.batch = (uint32_t)batches.size();
+					record.draw.batch_first = batch.first;
+					record.model = m;
+					record.instance = instance;
+					model_records[m].push_back((uint32_t)records.size());
+					records.push_back(record);
+					batch.count++;
+				}
+			}
+			if (batch.count != 0)
+				batches.push_back(batch);
+		}
+	}
+
+	reserve((uint32_t)records.size(), (uint32_t)batches.size());
+	visibility_reset = true;
+	layout_revision++;
+}
+
+void SVL::IndirectDraws::reserve(uint32_t draws, uint32_t batch_count)
+{
+	if (draws <= capacity && batch_count <= batch_capacity) return;
+
+	//recorded frames still read the old buffers
+	if (draw_buffer != VK_NULL_HANDLE)
+		vk_renderer.wait_for_device();
+	destroy_buffers();
+	capacity = grow_capacity(capacity, draws);
+	batch_capacity = grow_capacity(batch_capacity, batch_count);
+
+	VkDeviceSize frame_count = frames.size();
+	SVLTools::create_buffer(vk_renderer, frame_count * capacity * sizeof(IndirectDraw), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &draw_buffer, &draw_allocation);
+	SVLTools::create_buffer(vk_renderer, frame_count * capacity * sizeof(glm::mat4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &transform_buffer, &transform_allocation);
+	SVLTools::create_buffer(vk_renderer, frame_count * 2 * capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirect_buffer, &indirect_allocation);
+	SVLTools::create_buffer(vk_renderer, frame_count * 2 * batch_capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &count_buffer, &count_allocation);
+	SVLTools::create_buffer(vk_renderer, (VkDeviceSize)capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &visibility_buffer, &visibility_allocation);
+	visibility_reset = true;
+
+	for (uint32_t i = 0; i < frames.size(); i++)
+	{
+		VkDescriptorBufferInfo buffer_infos[5];
+		buffer_infos[0] = { draw_buffer, (VkDeviceSize)i * capacity * sizeof(IndirectDraw), (VkDeviceSize)capacity * sizeof(IndirectDraw) };
+		buffer_infos[1] = { transform_buffer, (VkDeviceSize)i * capacity * sizeof(glm::mat4), (VkDeviceSize)capacity * sizeof(glm::mat4) };
+		buffer_infos[2] = { indirect_buffer, (VkDeviceSize)i * 2 * capacity * sizeof(VkDrawIndexedIndirectCommand), (VkDeviceSize)2 * capacity * sizeof(VkDrawIndexedIndirectCommand) };
+		buffer_infos[3] = { count_buffer, (VkDeviceSize)i * 2 * batch_capacity * sizeof(uint32_t), (VkDeviceSize)2 * batch_capacity * sizeof(uint32_t) };
+		buffer_infos[4] = { visibility_buffer, 0, (VkDeviceSize)capacity * sizeof(uint32_t) };
+
+		VkWriteDescriptorSet writes[5] = {};
+		for (uint32_t j = 0; j < 5; j++)
+		{
+			writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[j].dstSet = frames[i].descriptor_set;
+			writes[j].dstBinding = j;
+			writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[j].descriptorCount = 1;
+			writes[j].pBufferInfo = &buffer_infos[j];
+		}
+		vkUpdateDescriptorSets(vk_renderer.device(), 5, writes, 0, nullptr);
+		frames[i].layout = UINT64_MAX;
+	}
+}
+
+void SVL::IndirectDraws::update(uint32_t frame)
+{
+	for (uint32_t m = 0; m < models.size(); m++)
+	{
+		if (models[m]->draw_revision() != draw_revisions[m])
+		{
+			layout();
+			break;
+		}
+	}
+	if (records.empty()) return;
+
+	Frame& slice = frames[frame];
+	IndirectDraw* draws = static_cast<IndirectDraw*>(draw_allocation.mapped) + (size_t)frame * capacity;
+	glm::mat4* transforms = static_cast<glm::mat4*>(transform_allocation.mapped) + (size_t)frame * capacity;
+	if (slice.layout != layout_revision)
+	{
+		slice.layout = layout_revision;
+		slice.transform_revisions.assign(models.size(), UINT64_MAX);
+		for (uint32_t i = 0; i < records.size(); i++)
+			draws[i] = records[i].draw;
+	}
+
+	//only models that moved since this slice was last written
+	for (uint32_t m = 0; m < models.size(); m++)
+	{
+		Model* model = models[m];
+		if (slice.transform_revisions[m] == model->transform_revision()) continue;
+		slice.transform_revisions[m] = model->transform_revision();
+
+		glm::mat4 transform = model->ubo_model();
+		for (uint32_t i : model_records[m])
+			transforms[i] = model->instanced() ? transform * model->instance_transforms()[records[i].instance] : transform;
+	}
+}
+
+void SVL::IndirectDraws::set_pyramid(const DepthPyramid* pyramid)
+{
+	//the sets of frames in flight are rewritten
+	vk_renderer.wait_for_device();
+	this->pyramid = pyramid;
+	visibility_reset = true;
+	write_pyramid();
+}
+
+void SVL::IndirectDraws::write_pyramid()
+{
+	VkDescriptorImageInfo image_info{ vk_sampler, pyramid != nullptr ? pyramid->view() : placeholder_view, VK_IMAGE_LAYOUT_GENERAL };
+	for (Frame& frame : frames)
+	{
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = frame.descriptor_set;
+		write.dstBinding = 5;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &image_info;
+		vkUpdateDescriptorSets(vk_renderer.device(), 1, &write, 0, nullptr);
+	}
+}
+
+void SVL::IndirectDraws::dispatch(VkCommandBuffer command_buffer, uint32_t frame, const Frustum& frustum, uint32_t phase)
+{
+	CullPushConstants push{};
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), std::begin(push.planes));
+	push.draw_count = (uint32_t)records.size();
+	push.phase = phase;
+	push.capacity = capacity;
+	push.batch_capacity = batch_capacity;
+
+	uint32_t occlusion_offset = occlusion_slot.dynamic_offset(frame);
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_pipeline_layout, 0, 1, &frames[frame].descriptor_set, 1, &occlusion_offset);
+	vkCmdPushConstants(command_buffer, vk_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+	vkCmdDispatch(command_buffer, (push.draw_count + cull_group_size - 1) / cull_group_size, 1, 1);
+}
+
+void SVL::IndirectDraws::cull_early(VkCommandBuffer command_buffer, uint32_t frame, const Frustum& frustum)
+{
+	if (records.empty() || pyramid == nullptr) return;
+
+	//the last frame's cull pass wrote the visibility, new records start out visible
+	if (visibility_reset)
+	{
+		vkCmdFillBuffer(command_buffer, visibility_buffer, 0, VK_WHOLE_SIZE, 1);
+		visibility_reset = false;
+	}
+	if (compact)
+		vkCmdFillBuffer(command_buffer, count_buffer, ((VkDeviceSize)frame * 2 + 1) * batch_capacity * sizeof(uint32_t), (VkDeviceSize)batch_capacity * sizeof(uint32_t), 0);
+	VkMemoryBarrier reset_barrier{};
+	reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reset_barrier, 0, nullptr, 0, nullptr);
+
+	dispatch(command_buffer, frame, frustum, 0);
+
+	//the main pass rewrites the visibility read here
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void SVL::IndirectDraws::cull(VkCommandBuffer command_buffer, uint32_t frame, const Frustum& frustum, const glm::mat4& view_projection)
+{
+	if (records.empty()) return;
+
+	if (pyramid == nullptr && !placeholder_initialized)
+	{
+		VkImageMemoryBarrier layout_barrier{};
+		layout_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		layout_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		layout_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		layout_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		layout_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		layout_barrier.image = placeholder.image;
+		layout_barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		layout_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &layout_barrier);
+		placeholder_initialized = true;
+	}
+
+	//recorded right before submission, the slot of frame is free
+	OcclusionUniforms& occlusion = *static_cast<OcclusionUniforms*>(occlusion_slot.data(frame));
+	occlusion.view_projection = view_projection;
+	occlusion.pyramid = pyramid != nullptr ? glm::vec4((float)pyramid->extent().width, (float)pyramid->extent().height, (float)pyramid->levels(), 0.0f) : glm::vec4(0.0f);
+
+	if (compact)
+	{
+		vkCmdFillBuffer(command_buffer, count_buffer, (VkDeviceSize)frame * 2 * batch_capacity * sizeof(uint32_t), (VkDeviceSize)batch_capacity * sizeof(uint32_t), 0);
+		VkMemoryBarrier reset_barrier{};
+		reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reset_barrier, 0, nullptr, 0, nullptr);
+	}
+
+	dispatch(command_buffer, frame, frustum, 1);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void SVL::IndirectDraws::draw(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, uint32_t frame)
+{
+	draw_batches(command_buffer, pipeline_layout, frame, false);
+}
+
+void SVL::IndirectDraws::draw_early(VkCommandBuffer command_buffer, uint32_t frame)
+{
+	//depth only, no material sets
+	draw_batches(command_buffer, VK_NULL_HANDLE, frame, true);
+}
+
+void SVL::IndirectDraws::draw_batches(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, uint32_t frame, bool early)
+{
+	if (records.empty()) return;
+
+	GeometryPool& geometry = vk_renderer.geometry();
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	bool multi_draw = vk_renderer.features().multiDrawIndirect == VK_TRUE;
+	VkDeviceSize first_command = ((VkDeviceSize)frame * 2 + (early ? 1 : 0)) * capacity;
+	VkDeviceSize first_count = ((VkDeviceSize)frame * 2 + (early ? 1 : 0)) * batch_capacity;
+	uint32_t page = UINT32_MAX;
+	for (uint32_t b = 0; b < batches.size(); b++)
+	{
+		const Batch& batch = batches[b];
+		if (batch.page != page)
+		{
+			page = batch.page;
+			VkBuffer vertex_buffers[] = { geometry.vertex_buffer(page), transform_buffer };
+			VkDeviceSize offsets[] = { 0, (VkDeviceSize)frame * capacity * sizeof(glm::mat4) };
+			vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+			vkCmdBindIndexBuffer(command_buffer, geometry.index_buffer(page), 0, VK_INDEX_TYPE_UINT32);
+		}
+		if (!early && batch.material != VK_NULL_HANDLE)
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 1, &batch.material, 0, nullptr);
+		else if (!early)
+			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, offsetof(ObjectPushConstants, material_index), sizeof(uint32_t), &batch.material_index);
+
+		VkDeviceSize offset = (first_command + batch.first) * stride;
+		if (compact)
+		{
+			VkDeviceSize count_offset = (first_count + b) * sizeof(uint32_t);
+			vk_renderer.draw_indexed_indirect_count()(command_buffer, indirect_buffer, offset, count_buffer, count_offset, batch.count, stride);
+		}
+		else if (multi_draw)
+			vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer, offset, batch.count, stride);
+		else
+		{
+			for (uint32_t i = 0; i < batch.count; i++)
+				vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer, offset + i * stride, 1, stride);
+		}
+	}
+}
+
+void SVL::IndirectDraws::destroy_buffers()
+{
+	if (draw_buffer == VK_NULL_HANDLE) return;
+	SVLTools::destroy_buffer(vk_renderer, visibility_buffer, visibility_allocation);
+	SVLTools::destroy_buffer(vk_renderer, count_buffer, count_allocation);
+	SVLTools::destroy_buffer(vk_renderer, indirect_buffer, indirect_allocation);
+	SVLTools::destroy_buffer(vk_renderer, transform_buffer, transform_allocation);
+	SVLTools::destroy_buffer(vk_renderer, draw_buffer, draw_allocation);
+}
@@ -0,0 +1,148 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+
+#include "memory.h"
+#include "culling.h"
+#include "uniform.h"
+#include "image.h"
+
+namespace SVL
+{
+	class Renderer;
+	class Model;
+	class DescriptorAllocator;
+	class DepthPyramid;
+
+	//per draw record read by the cull shader, std430
+	struct IndirectDraw
+	{
+		glm::vec4 bounds_min; //local space
+		glm::vec4 bounds_max;
+		uint32_t index_count;
+		uint32_t first_index;
+		int32_t vertex_offset;
+		uint32_t batch;
+		uint32_t batch_first; //first command of the batch
+		uint32_t padding[3];
+	};
+
+	//gpu driven drawing of a model list, geometry is read from the renderer geometry pool and every mesh instance gets a draw record
+	//a compute pass culls the records against the frustum and writes the indirect commands, one indirect draw per material
+	//record i is drawn with first instance i, its transform is read through instance binding 1
+	//with a depth pyramid the records visible in the last frame are drawn early into it, the pass then also tests against it
+	class DLLDIR IndirectDraws
+	{
+	public:
+		//needs drawIndirectFirstInstance, commands are compacted with VK_KHR_draw_indirect_count when available
+		static bool supported(const Renderer& renderer);
+
+		IndirectDraws(const Renderer& renderer, std::string cull_shader_path);
+		~IndirectDraws();
+
+		IndirectDraws(const IndirectDraws&) = delete;
+		IndirectDraws& operator=(const IndirectDraws&) = delete;
+		IndirectDraws(IndirectDraws&&) = delete;
+		IndirectDraws& operator=(IndirectDraws&&) = delete;
+
+		//lays out the records of models, their geometry stays in the renderer geometry pool
+		void build(const std::vector<Model*>& models);
+		//writes the records and transforms of frame that changed since it was last written
+		void update(uint32_t frame);
+		//outside the render pass, before the draws of frame
+		void cull(VkCommandBuffer command_buffer, uint32_t frame, const Frustum& frustum, const glm::mat4& view_projection);
+		//expects the pipeline, the scene set and an identity object set or push constant bound
+		//bindless layers bind their material set beforehand, batches then only push the material index
+		void draw(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, uint32_t frame);
+
+		//occlusion culling against pyramid, nullptr disables it, call again after the pyramid is resized
+		//waits for the device
+		void set_pyramid(const DepthPyramid* pyramid);
+		//outside any render pass, records that were visible in the last frame and pass the frustum
+		void cull_early(VkCommandBuffer command_buffer, uint32_t frame, const Frustum& frustum);
+		//the early records for the pyramid, without material sets
+		void draw_early(VkCommandBuffer command_buffer, uint32_t frame);
+
+		//bumped when recorded draws change, e.g. batches or buffers
+		const uint64_t revision() const { return layout_revision; }
+		const uint32_t draws_count() const { return (uint32_t)records.size(); }
+		const uint32_t batches_count() const { return (uint32_t)batches.size(); }
+	private:
+		const class Renderer& vk_renderer;
+		const bool compact; //culled commands are dropped instead of drawn with zero instances
+
+		std::vector<Model*> models;
+		std::vector<uint64_t> draw_revisions; //per model, records are laid out again when they move
+
+		struct Record
+		{
+			IndirectDraw draw;
+			uint32_t model;
+			uint32_t instance;
+		};
+		struct Batch
+		{
+			VkDescriptorSet material; //null for bindless materials
+			uint32_t material_index; //bindless index, pushed instead of binding set 1
+			uint32_t page; //of the geometry pool
+			uint32_t first;
+			uint32_t count;
+		};
+		std::vector<Record> records; //grouped by batch
+		std::vector<Batch> batches;
+		std::vector<std::vector<uint32_t>> model_records;
+		uint64_t layout_revision = 0;
+
+		//one slice per frame in flight, capacities are powers of two so slices keep the storage offset alignment
+		//command and count slices hold the main commands followed by the early ones
+		uint32_t capacity = 0;
+		uint32_t batch_capacity = 0;
+		VkBuffer draw_buffer = VK_NULL_HANDLE; //host visible
+		Allocation draw_allocation;
+		VkBuffer transform_buffer = VK_NULL_HANDLE; //host visible
+		Allocation transform_allocation;
+		VkBuffer indirect_buffer = VK_NULL_HANDLE;
+		Allocation indirect_allocation;
+		VkBuffer count_buffer = VK_NULL_HANDLE;
+		Allocation count_allocation;
+		VkBuffer visibility_buffer = VK_NULL_HANDLE; //per record, written by the last cull pass
+		Allocation visibility_allocation;
+		bool visibility_reset = true; //records changed, everything counts as visible once
+
+		const DepthPyramid* pyramid = nullptr;
+		UniformPool::Slot occlusion_slot;
+		Image placeholder; //bound instead of a pyramid
+		VkImageView placeholder_view = VK_NULL_HANDLE;
+		bool placeholder_initialized = false;
+		VkSampler vk_sampler = VK_NULL_HANDLE; //from the pipeline registry
+
+		struct Frame
+		{
+			VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+			uint64_t layout = UINT64_MAX; //layout revision the slice was written with
+			std::vector<uint64_t> transform_revisions; //per model
+		};
+		std::vector<Frame> frames;
+
+		DescriptorAllocator* vk_descriptor_allocator = nullptr;
+		VkDescriptorSetLayout vk_descriptor_set_layout = VK_NULL_HANDLE;
+		VkPipelineLayout vk_pipeline_layout = VK_NULL_HANDLE;
+		VkPipeline vk_pipeline = VK_NULL_HANDLE;
+
+		void layout();
+		void reserve(uint32_t draws, uint32_t batches);
+		void write_pyramid();
+		//early - the early commands without material sets, the pool page is rebound where batches change it
+		void draw_batches(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, uint32_t frame, bool early);
+		void dispatch(VkCommandBuffer command_buffer, uint32_t frame, const Frustum& frustum, uint32_t phase);
+		void destroy_buffers();
+	};
+}
+
+#endif // !INDIRECT_H
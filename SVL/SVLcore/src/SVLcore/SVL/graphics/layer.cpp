@@ -2,172 +2,172 @@
 #include "../common/ErrorHandler.h"
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cfloat>
 
 #include "renderer.h"
 #include "window.h"
 #include "model.h"
 #include "camera.h"
 #include "tools.h"
+#include "descriptor.h"
+#include "vertex.h"
+#include "hash.h"
+#include "depth_pyramid.h"
+#include "bindless.h"
 
-SVL::Layer3D::Layer3D(const Window& window, std::string vertex_shader_path, std::string fragment_shader_path, SVLTools::PipelineType pipeline_type)
-	: SVL::SecCommand(window.renderer()), vk_renderer(window.renderer()), vk_window(window), vertex_shader_path(vertex_shader_path), fragment_shader_path(fragment_shader_path), pipeline_type(pipeline_type)
+SVL::Layer3D::Layer3D(const Window& window, std::string vertex_shader_path, std::string fragment_shader_path, SVLTools::PipelineType pipeline_type, TransformSource transform_source)
+	: SVL::SecCommand(window.renderer()), vk_renderer(window.renderer()), vk_window(window), vertex_shader_path(vertex_shader_path), fragment_shader_path(fragment_shader_path), pipeline_type(pipeline_type), transform_source(transform_source)
 {
 	proj = glm::perspective(45.0f, (float)vk_window.extent().width / (float)vk_window.extent().height, 0.001f, 256.0f);
 	dummy_env = new SVL::Texture(vk_renderer, vk_window.command_pool(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+
+	create_descriptors();
+	create_pipeline();
+	invalidate();
+
+	SVLTools::create_buffer(vk_renderer, sizeof(Instance3D), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &identity_instance_buffer, &identity_instance_allocation);
+	static_cast<Instance3D*>(identity_instance_allocation.mapped)->transform = glm::mat4(1.0f);
 }
 SVL::Layer3D::~Layer3D()
 {
-	if(models.size() != 0)
-	{
-		destroy_command_buffers();
-	}
-	
-	if(models.size() != 0)
+	vk_window.wait_idle();
+	destroy_chunks();
+	delete indirect;
+	delete pyramid;
+	for(Model* obj : models)
 	{
-		destroy_pipeline();
-		destroy_descriptors();
+		obj->destroy_custom_pipelines();
+		destroy_object_descriptors(obj);
 	}
+	destroy_pipeline();
+	destroy_descriptors();
+	delete bindless;
+	SVLTools::destroy_buffer(vk_renderer, identity_instance_buffer, identity_instance_allocation);
 	delete dummy_env;
 }
 
 void SVL::Layer3D::update()
 {
-	if(models.size() == 0) return;
-
-	destroy_command_buffers();
+	//pipelines depend on the window extent and sample count, descriptors on the environment and materials
+	vk_window.wait_idle();
 	for(Model* obj : models)
 		obj->destroy_custom_pipelines();
-	destroy_pipeline();
-	destroy_descriptors();
+	if (pyramid != nullptr)
+	{
+		pyramid->resize(vk_window.extent());
+		indirect->set_pyramid(pyramid);
+	}
 
-	create_descriptors();
-	for(Model* obj : models)
-		obj->create_descriptor_sets(vk_descriptor_pool, { ubo_descriptor_set_layout, material_descriptor_set_layout }, environment ? environment : dummy_env);
-	create_pipeline();
+	create_pipeline(); //unchanged state gets the same pipelines back from the registry
+	if (bindless != nullptr)
+		bindless->set_environment(environment ? environment : dummy_env);
 	for(Model* obj : models)
+	{
+		create_object_descriptors(obj);
 		obj->create_custom_pipelines(vk_pipeline_layout);
-	create_command_buffers(vk_window.framebuffers()->size());
+	}
+	invalidate();
 }
 void SVL::Layer3D::update_uniforms()
 {
+	//writes the slice of the frame recorded next, the window keeps it free between draws
+	uint32_t frame = vk_window.frame_index();
+
+	glm::mat4 view = camera != nullptr ? camera->view() : glm::mat4();
+	SceneUniforms& scene = *static_cast<SceneUniforms*>(scene_uniform_slot.data(frame));
+	scene.proj = proj;
+	scene.view = view;
+	scene.view_pos = camera != nullptr ? glm::vec4(camera->position(), 1.0f) * -1.0f : glm::vec4(0.0f);
+	std::copy(point_lights.begin(), point_lights.end(), std::begin(scene.point_light));
+
+	//not read back from the mapped, possibly write combined, memory
+	if (indirect != nullptr)
+	{
+		view_projection = proj * view;
+		view_frustum = Frustum::from_matrix(view_projection);
+		indirect->update(frame);
+		return; //transforms are read from the indirect draws, object uniforms and instance buffers stay unused
+	}
+	if (culling)
+		update_visibility(view);
+
 	for (uint32_t i = 0; i < models.size(); i++)
 	{
-		if (camera != nullptr) models[i]->update_uniform(proj, camera->view(), point_lights, glm::vec4(camera->position(), 1.0f));
-		else models[i]->update_uniform(proj, glm::mat4(), point_lights, glm::vec4(0.0f));
+		if (transform_source == UniformTransform)
+			models[i]->update_uniform(frame);
+		models[i]->update_instances(frame);
 	}
 }
 
 void SVL::Layer3D::add_object(SVL::Model * object)
 {
-	if(models.size() != 0)
-	{
-		destroy_command_buffers();
-		for(Model* obj : models)
-			obj->destroy_custom_pipelines();
-		destroy_pipeline();
-		destroy_descriptors();
-	}
-
-	models.push_back(object);
-
-	create_descriptors();
-	for(Model* obj : models)
-		obj->create_descriptor_sets(vk_descriptor_pool, { ubo_descriptor_set_layout, material_descriptor_set_layout }, environment ? environment : dummy_env);
-	create_pipeline();
-	for(Model* obj : models)
-		obj->create_custom_pipelines(vk_pipeline_layout);
-	create_command_buffers(vk_window.framebuffers()->size());
+	add_object(std::vector<SVL::Model*>{ object });
 }
 void SVL::Layer3D::add_object(std::vector<SVL::Model*> obj)
 {
-	if(models.size() != 0)
+	//nothing in flight is touched, frames pick the new objects up once re-recorded
+	for(Model* o : obj)
 	{
-		destroy_command_buffers();
-		for(Model* obj : models)
-			obj->destroy_custom_pipelines();
-		destroy_pipeline();
-		destroy_descriptors();
+		create_object_descriptors(o);
+		o->create_custom_pipelines(vk_pipeline_layout);
 	}
-
 	models.insert(models.end(), obj.begin(), obj.end());
 
-	create_descriptors();
-	for(Model* obj : models)
-		obj->create_descriptor_sets(vk_descriptor_pool, { ubo_descriptor_set_layout, material_descriptor_set_layout }, environment ? environment : dummy_env);
-	create_pipeline();
-	for(Model* obj : models)
-		obj->create_custom_pipelines(vk_pipeline_layout);
-	create_command_buffers(vk_window.framebuffers()->size());
+	split_chunks();
+	invalidate();
 }
 void SVL::Layer3D::del_object(SVL::Model * object)
 {
-	if(models.size() != 0)
-	{
-		destroy_command_buffers();
-		for(Model* obj : models)
-			obj->destroy_custom_pipelines();
-		destroy_pipeline();
-		destroy_descriptors();
-	}
+	auto it = std::find(models.begin(), models.end(), object);
+	if(it == models.end()) return;
 
-	models.erase(std::remove(models.begin(), models.end(), object), models.end());
+	//frames in flight may still use the object, and callers usually delete it right after
+	vk_window.wait_idle();
+	object->destroy_custom_pipelines();
+	destroy_object_descriptors(object);
+	models.erase(it);
 
-	if(models.size() != 0)
-	{
-		create_descriptors();
-		for(Model* obj : models)
-			obj->create_descriptor_sets(vk_descriptor_pool, { ubo_descriptor_set_layout, material_descriptor_set_layout }, environment ? environment : dummy_env);
-		create_pipeline();
-		for(Model* obj : models)
-			obj->create_custom_pipelines(vk_pipeline_layout);
-		create_command_buffers(vk_window.framebuffers()->size());
-	}
+	split_chunks();
+	invalidate();
 }
 
 void SVL::Layer3D::create_descriptors()
 {
-	//pool
-	uint32_t materials = 0, objects_count = 0;
-	for (Model * obj : models)
-	{
-		objects_count += obj->objects_count();
-		materials += obj->materials_count();
-	}
-	std::array<VkDescriptorPoolSize, 2> pool_sizes = {};
-	pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	pool_sizes[0].descriptorCount = objects_count*2 + materials;
-	pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	pool_sizes[1].descriptorCount = materials*6;
-	VkDescriptorPoolCreateInfo pool_info{};
-	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	pool_info.poolSizeCount = pool_sizes.size();
-	pool_info.pPoolSizes = pool_sizes.data();
-	pool_info.maxSets = pool_sizes[1].descriptorCount == 0 ? 1 : pool_sizes[1].descriptorCount + objects_count;
-	ErrorCheck(vkCreateDescriptorPool(vk_renderer.device(), &pool_info, nullptr, &vk_descriptor_pool));
+	//pools, sized by the largest set of any layout
+	std::vector<VkDescriptorPoolSize> set_sizes(3);
+	set_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	set_sizes[0].descriptorCount = 1;
+	set_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	set_sizes[1].descriptorCount = 6;
+	set_sizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	set_sizes[2].descriptorCount = 1;
+	vk_descriptor_allocator = new DescriptorAllocator(vk_renderer, set_sizes);
 	//set_layout
-	VkDescriptorSetLayoutCreateInfo layout_info{};
-	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	//set0 binding0 - ubos
-	std::array<VkDescriptorSetLayoutBinding, 2> ubo_layout_binding = {};
-	ubo_layout_binding[0].binding = 0;
-	ubo_layout_binding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	ubo_layout_binding[0].descriptorCount = 1;
-	ubo_layout_binding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	ubo_layout_binding[0].pImmutableSamplers = nullptr;
-	ubo_layout_binding[1].binding = 1;
-	ubo_layout_binding[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	ubo_layout_binding[1].descriptorCount = 1;
-	ubo_layout_binding[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-	ubo_layout_binding[1].pImmutableSamplers = nullptr;
-	layout_info.bindingCount = ubo_layout_binding.size();
-	layout_info.pBindings = ubo_layout_binding.data();
-	ErrorCheck(vkCreateDescriptorSetLayout(vk_renderer.device(), &layout_info, nullptr, &ubo_descriptor_set_layout));
+	//set0 binding0 - scene ubo
+	VkDescriptorSetLayoutBinding scene_layout_binding{};
+	scene_layout_binding.binding = 0;
+	scene_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	scene_layout_binding.descriptorCount = 1;
+	scene_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	scene_layout_binding.pImmutableSamplers = nullptr;
+	scene_descriptor_set_layout = vk_renderer.pipelines().descriptor_set_layout({ scene_layout_binding });
+	//set2 binding0 - object ubo
+	VkDescriptorSetLayoutBinding object_layout_binding{};
+	object_layout_binding.binding = 0;
+	object_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	object_layout_binding.descriptorCount = 1;
+	object_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	object_layout_binding.pImmutableSamplers = nullptr;
+	object_descriptor_set_layout = vk_renderer.pipelines().descriptor_set_layout({ object_layout_binding });
 	//set1 binding0 - materials
+	//every material texture and the environment use the default texture sampler, baked into the layout
+	VkSampler material_sampler = vk_renderer.pipelines().sampler(Texture::sampler_info(0));
 	std::array<VkDescriptorSetLayoutBinding, 7> sampler_layout_bindings = {};
 	sampler_layout_bindings[0].binding = 1;
 	sampler_layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	sampler_layout_bindings[0].descriptorCount = 1;
-	sampler_layout_bindings[0].pImmutableSamplers = nullptr;
+	sampler_layout_bindings[0].pImmutableSamplers = &material_sampler;
 	sampler_layout_bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	sampler_layout_bindings[1].binding = 0;
 	sampler_layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -177,77 +177,516 @@ void SVL::Layer3D::create_descriptors()
 	sampler_layout_bindings[2].binding = 2;
 	sampler_layout_bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	sampler_layout_bindings[2].descriptorCount = 1;
-	sampler_layout_bindings[2].pImmutableSamplers = nullptr;
+	sampler_layout_bindings[2].pImmutableSamplers = &material_sampler;
 	sampler_layout_bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	sampler_layout_bindings[3].binding = 3;
 	sampler_layout_bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	sampler_layout_bindings[3].descriptorCount = 1;
-	sampler_layout_bindings[3].pImmutableSamplers = nullptr;
+	sampler_layout_bindings[3].pImmutableSamplers = &material_sampler;
 	sampler_layout_bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	sampler_layout_bindings[4].binding = 4;
 	sampler_layout_bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	sampler_layout_bindings[4].descriptorCount = 1;
-	sampler_layout_bindings[4].pImmutableSamplers = nullptr;
+	sampler_layout_bindings[4].pImmutableSamplers = &material_sampler;
 	sampler_layout_bindings[4].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	sampler_layout_bindings[5].binding = 5;
 	sampler_layout_bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	sampler_layout_bindings[5].descriptorCount = 1;
-	sampler_layout_bindings[5].pImmutableSamplers = nullptr;
+	sampler_layout_bindings[5].pImmutableSamplers = &material_sampler;
 	sampler_layout_bindings[5].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	sampler_layout_bindings[6].binding = 6;
 	sampler_layout_bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	sampler_layout_bindings[6].descriptorCount = 1;
-	sampler_layout_bindings[6].pImmutableSamplers = nullptr;
+	sampler_layout_bindings[6].pImmutableSamplers = &material_sampler;
 	sampler_layout_bindings[6].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-	layout_info.bindingCount = sampler_layout_bindings.size();
-	layout_info.pBindings = sampler_layout_bindings.data();
-	ErrorCheck(vkCreateDescriptorSetLayout(vk_renderer.device(), &layout_info, nullptr, &material_descriptor_set_layout));
+	material_descriptor_set_layout = vk_renderer.pipelines().descriptor_set_layout({ sampler_layout_bindings.begin(), sampler_layout_bindings.end() });
+
+	//scene set, one slice per frame in flight
+	scene_uniform_slot = vk_renderer.uniforms().allocate(sizeof(SceneUniforms));
+	scene_uniform_descriptor.buffer = scene_uniform_slot.buffer;
+	scene_uniform_descriptor.offset = 0;
+	scene_uniform_descriptor.range = scene_uniform_slot.size;
+	scene_descriptor_set = vk_descriptor_allocator->allocate(scene_descriptor_set_layout);
+
+	VkWriteDescriptorSet scene_write{};
+	scene_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	scene_write.dstSet = scene_descriptor_set;
+	scene_write.dstBinding = 0;
+	scene_write.dstArrayElement = 0;
+	scene_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	scene_write.descriptorCount = 1;
+	scene_write.pBufferInfo = &scene_uniform_descriptor;
+	vkUpdateDescriptorSets(vk_renderer.device(), 1, &scene_write, 0, nullptr);
+
+	//identity object set, bound instead of model sets for push constant transforms and gpu driven draws
+	fallback_object_slot = vk_renderer.uniforms().allocate(sizeof(ObjectUniforms));
+	for (uint32_t i = 0; i < vk_renderer.frames_in_flight(); i++)
+		static_cast<ObjectUniforms*>(fallback_object_slot.data(i))->model = glm::mat4(1.0f);
+	fallback_object_descriptor.buffer = fallback_object_slot.buffer;
+	fallback_object_descriptor.offset = 0;
+	fallback_object_descriptor.range = fallback_object_slot.size;
+	fallback_object_descriptor_set = vk_descriptor_allocator->allocate(object_descriptor_set_layout);
+
+	VkWriteDescriptorSet object_write = scene_write;
+	object_write.dstSet = fallback_object_descriptor_set;
+	object_write.pBufferInfo = &fallback_object_descriptor;
+	vkUpdateDescriptorSets(vk_renderer.device(), 1, &object_write, 0, nullptr);
+}
+void SVL::Layer3D::create_object_descriptors(Model* object)
+{
+	VkDescriptorSetLayout object_layout = transform_source == UniformTransform ? object_descriptor_set_layout : VK_NULL_HANDLE;
+	if (bindless == nullptr)
+	{
+		object->create_descriptor_sets(*vk_descriptor_allocator, { object_layout, material_descriptor_set_layout }, environment ? environment : dummy_env);
+		return;
+	}
+	object->create_descriptor_sets(*vk_descriptor_allocator, { object_layout, VK_NULL_HANDLE });
+	//entries of materials already added are rewritten, materials may have changed since
+	for (Material& material : object->get_materials())
+	{
+		if (material.bindless_index == UINT32_MAX)
+			bindless->add(material);
+		else
+			bindless->update(material);
+	}
+}
+void SVL::Layer3D::destroy_object_descriptors(Model* object)
+{
+	object->destroy_descriptor_sets(*vk_descriptor_allocator);
+	if (bindless == nullptr) return;
+	for (Material& material : object->get_materials())
+		bindless->remove(material);
 }
 void SVL::Layer3D::destroy_descriptors()
 {
-	vkDestroyDescriptorSetLayout(vk_renderer.device(), material_descriptor_set_layout, nullptr);
-	vkDestroyDescriptorSetLayout(vk_renderer.device(), ubo_descriptor_set_layout, nullptr);
-	vkDestroyDescriptorPool(vk_renderer.device(), vk_descriptor_pool, nullptr);
+	vk_descriptor_allocator->free(fallback_object_descriptor_set);
+	vk_renderer.uniforms().free(fallback_object_slot);
+	vk_descriptor_allocator->free(scene_descriptor_set);
+	vk_renderer.uniforms().free(scene_uniform_slot);
+	delete vk_descriptor_allocator;
 }
 
 void SVL::Layer3D::create_pipeline()
 {
-	//pipeline_layout
-	std::array<VkDescriptorSetLayout, 2> layouts = { ubo_descriptor_set_layout, material_descriptor_set_layout };
-	VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
-	pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_create_info.setLayoutCount = layouts.size();
-	pipeline_layout_create_info.pSetLayouts = layouts.data();
-	ErrorCheck(vkCreatePipelineLayout(vk_renderer.device(), &pipeline_layout_create_info, nullptr, &vk_pipeline_layout));
+	PipelineRegistry& registry = vk_renderer.pipelines();
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(ObjectPushConstants);
+	VkDescriptorSetLayout material_layout = bindless != nullptr ? bindless->descriptor_set_layout() : material_descriptor_set_layout;
+	vk_pipeline_layout = registry.pipeline_layout({ scene_descriptor_set_layout, material_layout, object_descriptor_set_layout }, { push_constant_range });
+
+	if (vertex_shader_module == VK_NULL_HANDLE)
+		vertex_shader_module = registry.shader_module(SVLTools::read_file(vertex_shader_path));
+	if (fragment_shader_module == VK_NULL_HANDLE)
+		fragment_shader_module = registry.shader_module(SVLTools::read_file(fragment_shader_path));
+	VkShaderModule fragment_module = bindless != nullptr ? bindless_fragment_shader_module : fragment_shader_module;
 
-	std::vector<byte> vertex_shader_code = SVLTools::read_file(vertex_shader_path);
-	std::vector<byte> fragment_shader_code = SVLTools::read_file(fragment_shader_path);
+	//constant 0 - transform source, read by both stages
+	VkBool32 push_constant_transform = transform_source == PushConstantTransform ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry specialization_entry{ 0, 0, sizeof(VkBool32) };
+	VkSpecializationInfo specialization{ 1, &specialization_entry, sizeof(VkBool32), &push_constant_transform };
 
-	vertex_shader_module = SVLTools::create_shader_module(vk_renderer.device(), vertex_shader_code);
-	fragment_shader_module = SVLTools::create_shader_module(vk_renderer.device(), fragment_shader_code);
+	SVL::init::PipelineInit init = SVLTools::create_predefined_pipeline(vk_window.extent(), vk_window.get_sample_count(), vertex_shader_module, fragment_module, pipeline_type);
+	SVL::init::PipelineInit blend_init = SVLTools::create_predefined_pipeline(vk_window.extent(), vk_window.get_sample_count(), vertex_shader_module, fragment_module, SVLTools::Blend);
+	for (VkPipelineShaderStageCreateInfo& stage : init.stages)
+		stage.pSpecializationInfo = &specialization;
+	for (VkPipelineShaderStageCreateInfo& stage : blend_init.stages)
+		stage.pSpecializationInfo = &specialization;
 
-	vk_pipeline = new SVL::Pipeline(vk_renderer, vk_window.render_pass(), vk_pipeline_layout, SVLTools::create_predefined_pipeline(vk_window.extent(), vk_window.get_sample_count(), vertex_shader_module, fragment_shader_module, pipeline_type));
-	vk_blend_pipeline = new SVL::Pipeline(vk_renderer, vk_window.render_pass(), vk_pipeline_layout, SVLTools::create_predefined_pipeline(vk_window.extent(), vk_window.get_sample_count(), vertex_shader_module, fragment_shader_module, SVLTools::Blend));
+	vk_pipeline = registry.pipeline(vk_window.render_pass(), vk_window.render_pass_hash(), vk_pipeline_layout, init);
+	vk_blend_pipeline = registry.pipeline(vk_window.render_pass(), vk_window.render_pass_hash(), vk_pipeline_layout, blend_init);
+
+	if (pyramid != nullptr)
+	{
+		//same vertex stage, so the pyramid sees the depth the main pass will
+		SVL::init::PipelineInit depth_init = SVLTools::create_predefined_pipeline(pyramid->target_extent(), VK_SAMPLE_COUNT_1_BIT, vertex_shader_module, fragment_shader_module, SVLTools::Solid);
+		depth_init.stages.erase(std::remove_if(depth_init.stages.begin(), depth_init.stages.end(), [](const VkPipelineShaderStageCreateInfo& stage) { return stage.stage != VK_SHADER_STAGE_VERTEX_BIT; }), depth_init.stages.end());
+		for (VkPipelineShaderStageCreateInfo& stage : depth_init.stages)
+			stage.pSpecializationInfo = &specialization;
+		depth_init.color_blend_attachment_states.clear();
+		vk_depth_pipeline = registry.pipeline(pyramid->render_pass()(), pyramid->render_pass().compatibility_hash(), vk_pipeline_layout, depth_init);
+	}
 }
 void SVL::Layer3D::destroy_pipeline()
 {
-	delete vk_blend_pipeline;
-	delete vk_pipeline;
-	vkDestroyShaderModule(vk_renderer.device(), fragment_shader_module, nullptr);
-	vkDestroyShaderModule(vk_renderer.device(), vertex_shader_module, nullptr);
-	vkDestroyPipelineLayout(vk_renderer.device(), vk_pipeline_layout, nullptr);
+	vk_depth_pipeline.reset();
+	vk_blend_pipeline.reset();
+	vk_pipeline.reset();
+}
+
+void SVL::Layer3D::invalidate()
+{
+	dirty.assign(vk_window.frames_in_flight(), true);
+}
+
+void SVL::Layer3D::set_frustum_culling(bool enable)
+{
+	if (culling == enable) return;
+	culling = enable;
+	mesh_visible.assign(mesh_visible.size(), 1);
+	invalidate();
+}
+
+bool SVL::Layer3D::set_gpu_driven(std::string cull_shader_path)
+{
+	if (!cull_shader_path.empty() && !IndirectDraws::supported(vk_renderer))
+	{
+		Log("SVL: device cannot draw indirectly with first instance, layer keeps cpu recorded draws.");
+		return false;
+	}
+
+	vk_window.wait_idle();
+	if (indirect != nullptr)
+	{
+		delete pyramid;
+		pyramid = nullptr;
+		vk_depth_pipeline.reset();
+		delete indirect;
+		indirect = nullptr;
+		vkDestroyCommandPool(vk_renderer.device(), indirect_chunk.command_pool, nullptr);
+		indirect_chunk = Chunk();
+	}
+	if (!cull_shader_path.empty())
+	{
+		indirect = new IndirectDraws(vk_renderer, cull_shader_path);
+		create_chunk(indirect_chunk);
+		indirect->build(models);
+	}
+	invalidate();
+	return true;
+}
+
+const SVL::DrawList::Stats SVL::Layer3D::draw_stats() const
+{
+	DrawList::Stats total;
+	if(indirect != nullptr) return total;
+	for(const Chunk& chunk : chunks)
+	{
+		total.draws += chunk.stats.draws;
+		total.binds += chunk.stats.binds;
+		total.redundant_binds += chunk.stats.redundant_binds;
+	}
+	return total;
+}
+
+bool SVL::Layer3D::set_occlusion_culling(std::string downsample_shader_path)
+{
+	if (indirect == nullptr)
+	{
+		Log("SVL: occlusion culling needs a gpu driven layer.");
+		return false;
+	}
+
+	vk_window.wait_idle();
+	delete pyramid;
+	pyramid = nullptr;
+	vk_depth_pipeline.reset();
+	if (!downsample_shader_path.empty())
+	{
+		pyramid = new DepthPyramid(vk_renderer, downsample_shader_path);
+		pyramid->resize(vk_window.extent());
+		create_pipeline();
+	}
+	indirect->set_pyramid(pyramid);
+	invalidate();
+	return true;
+}
+
+bool SVL::Layer3D::set_bindless_materials(std::string fragment_shader_path)
+{
+	if (!fragment_shader_path.empty() && !BindlessMaterials::supported(vk_renderer))
+	{
+		Log("SVL: device has no descriptor indexing, layer keeps a set per material.");
+		return false;
+	}
+
+	vk_window.wait_idle();
+	for (Model* obj : models)
+		destroy_object_descriptors(obj);
+	delete bindless;
+	bindless = nullptr;
+	bindless_fragment_shader_module = VK_NULL_HANDLE;
+	if (!fragment_shader_path.empty())
+	{
+		bindless = new BindlessMaterials(vk_renderer);
+		bindless_fragment_shader_module = vk_renderer.pipelines().shader_module(SVLTools::read_file(fragment_shader_path));
+	}
+	//new pipeline layout, sets and material entries for every object
+	update();
+	//batches hold the material sets
+	if (indirect != nullptr)
+		indirect->build(models);
+	return true;
+}
+
+void SVL::Layer3D::record_pre_render_pass(VkCommandBuffer command_buffer, uint32_t index)
+{
+	if (indirect == nullptr) return;
+	Frustum frustum = view_frustum;
+	if (!culling)
+	{
+		for (glm::vec4& plane : frustum.planes)
+			plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	if (pyramid != nullptr)
+	{
+		//last frame's visible objects from the current view are the occluders, the rest is tested against them
+		pyramid->prepare(command_buffer);
+		indirect->cull_early(command_buffer, index, frustum);
+		pyramid->begin(command_buffer);
+
+		uint32_t scene_offset = scene_uniform_slot.dynamic_offset(index);
+		uint32_t object_offset = fallback_object_slot.dynamic_offset(index);
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (*vk_depth_pipeline)());
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &scene_descriptor_set, 1, &scene_offset);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 2, 1, &fallback_object_descriptor_set, 1, &object_offset);
+		if (transform_source == PushConstantTransform)
+		{
+			ObjectPushConstants push{};
+			push.model = glm::mat4(1.0f);
+			vkCmdPushConstants(command_buffer, vk_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectPushConstants), &push);
+		}
+		indirect->draw_early(command_buffer, index);
+
+		pyramid->end(command_buffer);
+		pyramid->build(command_buffer);
+	}
+	indirect->cull(command_buffer, index, frustum, view_projection);
+}
+
+void SVL::Layer3D::update_bounds()
+{
+	//world bounds follow the transform, only models that moved are recomputed
+	if (mesh_offsets.empty()) return;
+	std::vector<BVH::Box> boxes;
+	if (!mesh_bvh_built)
+		boxes.resize(mesh_offsets.back());
+
+	for (uint32_t i = 0; i < models.size(); i++)
+	{
+		Model* model = models[i];
+		uint64_t revision = model->transform_revision() + model->draw_revision();
+		if (mesh_bvh_built && bounds_revisions[i] == revision) continue;
+		bounds_revisions[i] = revision;
+
+		const std::vector<Mesh>& meshes = model->get_meshes();
+		for (uint32_t j = 0; j < meshes.size(); j++)
+		{
+			BVH::Box box;
+			if (model->instanced())
+			{
+				//no instances draw nothing, a point keeps the box valid
+				glm::vec3 position = glm::vec3(model->ubo_model()[3]);
+				box = { position, position };
+				if (!model->instance_transforms().empty())
+					box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+				for (const glm::mat4& instance : model->instance_transforms())
+				{
+					BVH::Box b = BVH::Box::transformed(meshes[j].bounds_min, meshes[j].bounds_max, model->ubo_model() * instance);
+					box.min = glm::min(box.min, b.min);
+					box.max = glm::max(box.max, b.max);
+				}
+			}
+			else
+				box = BVH::Box::transformed(meshes[j].bounds_min, meshes[j].bounds_max, model->ubo_model());
+
+			if (mesh_bvh_built) mesh_bvh.update(mesh_offsets[i] + j, box);
+			else boxes[mesh_offsets[i] + j] = box;
+		}
+	}
+
+	if (!mesh_bvh_built)
+		mesh_bvh.build(boxes);
+	else if (mesh_bvh.rebuild_needed())
+		mesh_bvh.build(mesh_bvh.get_bounds());
+	mesh_bvh_built = true;
+}
+
+void SVL::Layer3D::update_visibility(const glm::mat4& view)
+{
+	update_bounds();
+	mesh_bvh.cull(Frustum::from_matrix(proj * view), mesh_visible.data());
+}
+
+const SVL::BVH& SVL::Layer3D::bvh()
+{
+	update_bounds();
+	return mesh_bvh;
+}
+
+SVL::Model* SVL::Layer3D::mesh_object(uint32_t mesh) const
+{
+	//last model starting at or before the mesh, models without meshes share their offset with the next one
+	uint32_t i = (uint32_t)(std::upper_bound(mesh_offsets.begin(), mesh_offsets.end(), mesh) - mesh_offsets.begin()) - 1;
+	return models[i];
+}
+
+SVL::Model* SVL::Layer3D::pick(glm::vec3 origin, glm::vec3 direction, float* distance)
+{
+	if (models.size() == 0) return nullptr;
+	update_bounds();
+	uint32_t mesh = mesh_bvh.raycast(origin, direction, FLT_MAX, distance);
+	return mesh != UINT32_MAX ? mesh_object(mesh) : nullptr;
+}
+
+std::vector<SVL::Model*> SVL::Layer3D::query(glm::vec3 min, glm::vec3 max)
+{
+	std::vector<Model*> objects;
+	if (models.size() == 0) return objects;
+	update_bounds();
+
+	std::vector<uint32_t> meshes;
+	mesh_bvh.query({ min, max }, meshes);
+	std::sort(meshes.begin(), meshes.end());
+	for (uint32_t mesh : meshes)
+	{
+		Model* object = mesh_object(mesh);
+		if (objects.empty() || objects.back() != object)
+			objects.push_back(object);
+	}
+	return objects;
 }
 
 void SVL::Layer3D::update_command_buffers(VkCommandBufferInheritanceInfo inheritanceInfo, uint32_t index)
 {
 	if(models.size() == 0) return;
+	bool all = dirty[index];
+	dirty[index] = false;
+
+	if(indirect != nullptr)
+	{
+		if(chunk_outdated(indirect_chunk, index) || all)
+			record_chunk(indirect_chunk, inheritanceInfo, index);
+		return;
+	}
+	for(Chunk& chunk : chunks)
+	{
+		if(chunk.count == 0) continue;
+		if(chunk_outdated(chunk, index) || all)
+			record_chunk(chunk, inheritanceInfo, index);
+	}
+}
+
+void SVL::Layer3D::record_command_buffers(VkCommandBufferInheritanceInfo inheritance_info, uint32_t index, ThreadPool& pool)
+{
+	if(models.size() == 0) return;
+	bool all = dirty[index];
+	dirty[index] = false;
+
+	//a single secondary, recording it inline is cheaper than a task
+	if(indirect != nullptr)
+	{
+		if(chunk_outdated(indirect_chunk, index) || all)
+			record_chunk(indirect_chunk, inheritance_info, index);
+		return;
+	}
+	//every chunk has its own command pool, so chunks record concurrently
+	for(Chunk& chunk : chunks)
+	{
+		if(chunk.count == 0) continue;
+		if(!chunk_outdated(chunk, index) && !all) continue;
+		Chunk* c = &chunk;
+		pool.push([this, c, inheritance_info, index]() { record_chunk(*c, inheritance_info, index); });
+	}
+}
+
+std::vector<VkCommandBuffer> SVL::Layer3D::secondary_command_buffers(uint32_t index)
+{
+	std::vector<VkCommandBuffer> buffers;
+	if(indirect != nullptr)
+	{
+		if(models.size() != 0)
+			buffers.push_back(indirect_chunk.command_buffers[index]);
+		return buffers;
+	}
+	for(Chunk& chunk : chunks)
+	{
+		if(chunk.count != 0)
+			buffers.push_back(chunk.command_buffers[index]);
+	}
+	return buffers;
+}
+
+void SVL::Layer3D::split_chunks()
+{
+	//split models into ranges of roughly RECORD_CHUNK_DRAWS draws
+	//chunks left over after a removal stay empty, their buffers may still be pending on the gpu
+	for(Chunk& chunk : chunks)
+	{
+		chunk.count = 0;
+		chunk.stats = DrawList::Stats();
+	}
+
+	mesh_offsets.resize(models.size() + 1);
+	mesh_offsets[0] = 0;
+	for(uint32_t i = 0; i < models.size(); i++)
+		mesh_offsets[i + 1] = mesh_offsets[i] + models[i]->meshes_count();
+	mesh_bvh_built = false;
+	mesh_visible.assign(mesh_offsets.back(), 1);
+	bounds_revisions.assign(models.size(), UINT64_MAX);
+
+	uint32_t current = 0, draws = 0;
+	for(uint32_t i = 0; i < models.size(); i++)
+	{
+		if(i != 0 && draws >= RECORD_CHUNK_DRAWS)
+		{
+			current++;
+			draws = 0;
+		}
+		if(current == chunks.size())
+		{
+			Chunk chunk;
+			create_chunk(chunk);
+			chunks.push_back(chunk);
+		}
+		if(chunks[current].count == 0)
+			chunks[current].first = i;
+		chunks[current].count++;
+		draws += models[i]->meshes_count();
+	}
+
+	if(indirect != nullptr)
+		indirect->build(models);
+}
+void SVL::Layer3D::create_chunk(Chunk& chunk)
+{
+	VkCommandPoolCreateInfo command_pool_info{};
+	command_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	command_pool_info.queueFamilyIndex = vk_renderer.graphics_family_index();
+	command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	ErrorCheck(vkCreateCommandPool(vk_renderer.device(), &command_pool_info, nullptr, &chunk.command_pool));
+
+	chunk.command_buffers.resize(vk_window.frames_in_flight());
+	chunk.revisions.assign(vk_window.frames_in_flight(), 0);
+	VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+	command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	command_buffer_allocate_info.commandPool = chunk.command_pool;
+	command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	command_buffer_allocate_info.commandBufferCount = chunk.command_buffers.size();
+	ErrorCheck(vkAllocateCommandBuffers(vk_renderer.device(), &command_buffer_allocate_info, chunk.command_buffers.data()));
+}
+void SVL::Layer3D::destroy_chunks()
+{
+	for(Chunk& chunk : chunks)
+		vkDestroyCommandPool(vk_renderer.device(), chunk.command_pool, nullptr);
+	chunks.clear();
+	if(indirect_chunk.command_pool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(vk_renderer.device(), indirect_chunk.command_pool, nullptr);
+	indirect_chunk = Chunk();
+}
+
+void SVL::Layer3D::record_chunk(Chunk& chunk, VkCommandBufferInheritanceInfo inheritance_info, uint32_t index)
+{
+	VkCommandBuffer command_buffer = chunk.command_buffers[index];
 
 	VkCommandBufferBeginInfo command_buffer_begin_info = {};
 	command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-	command_buffer_begin_info.pInheritanceInfo = &inheritanceInfo;
+	command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	command_buffer_begin_info.pInheritanceInfo = &inheritance_info;
 
-	ErrorCheck(vkBeginCommandBuffer(vk_command_buffers[index], &command_buffer_begin_info));
+	ErrorCheck(vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
 
 	VkViewport viewport = {};
 	viewport.x = 0.0f;
@@ -256,17 +695,81 @@ void SVL::Layer3D::update_command_buffers(VkCommandBufferInheritanceInfo inherit
 	viewport.height = vk_window.extent().height;
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(vk_command_buffers[index], 0, 1, &viewport);
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
 	VkRect2D scissor = {};
 	scissor.offset = { 0,0 };
 	scissor.extent = vk_window.extent();
-	vkCmdSetScissor(vk_command_buffers[index], 0, 1, &scissor);
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-	for(Model* obj : models)
+	//models only rebind the material and object sets, bindless layers bind set 1 once here
+	uint32_t scene_offset = scene_uniform_slot.dynamic_offset(index);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &scene_descriptor_set, 1, &scene_offset);
+	if(bindless != nullptr)
+	{
+		VkDescriptorSet material_set = bindless->descriptor_set();
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 1, 1, &material_set, 0, nullptr);
+	}
+	bool push_constants = transform_source == PushConstantTransform;
+	if(push_constants || indirect != nullptr)
+	{
+		uint32_t object_offset = fallback_object_slot.dynamic_offset(index);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 2, 1, &fallback_object_descriptor_set, 1, &object_offset);
+	}
+
+	if(indirect != nullptr)
+	{
+		//transforms are complete per draw, the pushed or bound object transform stays identity
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (*vk_pipeline)());
+		if(push_constants)
+		{
+			ObjectPushConstants push{};
+			push.model = glm::mat4(1.0f);
+			vkCmdPushConstants(command_buffer, vk_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectPushConstants), &push);
+		}
+		indirect->draw(command_buffer, vk_pipeline_layout, index);
+		ErrorCheck(vkEndCommandBuffer(command_buffer));
+		return;
+	}
+
+	//depth of the recording camera, only breaks ties between draws of equal state
+	glm::mat4 view = camera != nullptr ? camera->view() : glm::mat4();
+	chunk.draws.clear();
+	for(uint32_t i = chunk.first; i < chunk.first + chunk.count; i++)
+	{
+		const uint8_t* visible = culling ? mesh_visible.data() + mesh_offsets[i] : nullptr;
+		models[i]->add_draws(chunk.draws, {(*vk_pipeline)(), (*vk_blend_pipeline)()}, index, identity_instance_buffer, view, push_constants, visible);
+	}
+	chunk.draws.sort();
+	chunk.stats = chunk.draws.record(command_buffer, vk_pipeline_layout, push_constants);
+
+	ErrorCheck(vkEndCommandBuffer(command_buffer));
+}
+
+bool SVL::Layer3D::chunk_outdated(Chunk& chunk, uint32_t index)
+{
+	if(indirect != nullptr && &chunk == &indirect_chunk)
+	{
+		bool outdated = indirect->revision() != chunk.revisions[index];
+		chunk.revisions[index] = indirect->revision();
+		return outdated;
+	}
+	//revisions only grow, so the sum moves whenever any model in the chunk changed
+	bool push_constants = transform_source == PushConstantTransform;
+	uint64_t revision = 0;
+	for(uint32_t i = chunk.first; i < chunk.first + chunk.count; i++)
+	{
+		revision += models[i]->draw_revision();
+		if(push_constants)
+			revision += models[i]->transform_revision();
+	}
+	if(culling)
 	{
-		obj->render(vk_command_buffers[index], {(*vk_pipeline)(), (*vk_blend_pipeline)()}, vk_pipeline_layout);
+		uint32_t first = mesh_offsets[chunk.first], last = mesh_offsets[chunk.first + chunk.count];
+		revision = Hasher().add(revision).add(mesh_visible.data() + first, last - first).value();
 	}
 
-	ErrorCheck(vkEndCommandBuffer(vk_command_buffers[index]));
+	bool outdated = revision != chunk.revisions[index];
+	chunk.revisions[index] = revision;
+	return outdated;
 }
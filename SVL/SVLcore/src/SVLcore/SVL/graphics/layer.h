@@ -6,6 +6,7 @@
 
 #include <map>
 #include <array>
+#include <memory>
 #include <glm/glm.hpp>
 
 #include "tools.h"
@@ -13,6 +14,11 @@
 #include "command.h"
 #include "pipeline.h"
 #include "texture.h"
+#include "uniform.h"
+#include "culling.h"
+#include "bvh.h"
+#include "indirect.h"
+#include "draw_list.h"
 
 namespace SVL
 {
@@ -20,10 +26,30 @@ namespace SVL
 	class Window;
 	class Model;
 	class Camera;
+	class DescriptorAllocator;
+	class DepthPyramid;
+	class BindlessMaterials;
+
+	//per frame, set 0, written once per layer and shared by all its models
+	struct SceneUniforms
+	{
+		glm::mat4 view;
+		glm::mat4 proj;
+		glm::vec4 view_pos;
+		PointLight point_light[4];
+	};
+
+	enum TransformSource
+	{
+		UniformTransform, //object set with a per frame ubo, static objects cost nothing per frame
+		PushConstantTransform //pushed per draw, moving objects re-record their chunk instead of writing buffers
+	};
+
 	class DLLDIR Layer3D : public SecCommand
 	{
 	public:
-		Layer3D(const Window& window, std::string vertex_shader_path, std::string fragment_shader_path, SVLTools::PipelineType pipeline_type = SVLTools::Solid);
+		//shaders select the transform source through specialization constant 0
+		Layer3D(const Window& window, std::string vertex_shader_path, std::string fragment_shader_path, SVLTools::PipelineType pipeline_type = SVLTools::Solid, TransformSource transform_source = UniformTransform);
 		~Layer3D();
 
 		Layer3D(const Layer3D&) = delete;
@@ -37,7 +63,47 @@ namespace SVL
 
 		void update();
 		void update_uniforms();
+		//re-records only frames invalidated since their last recording
 		void update_command_buffers(VkCommandBufferInheritanceInfo inheritanceInfo, uint32_t index);
+		void record_command_buffers(VkCommandBufferInheritanceInfo inheritance_info, uint32_t index, ThreadPool& pool);
+		std::vector<VkCommandBuffer> secondary_command_buffers(uint32_t index);
+		void record_pre_render_pass(VkCommandBuffer command_buffer, uint32_t index);
+		//call after changing anything recorded into the command buffers, e.g. model meshes or materials
+		void invalidate();
+
+		//tests mesh bounds against the camera frustum in update_uniforms, chunks re-record when visibility changes
+		//instanced models are bounded by all their instances
+		void set_frustum_culling(bool enable);
+		const bool frustum_culling() const { return culling; }
+
+		//draws every object through IndirectDraws, frustum culling then runs in the compiled cull.comp at cull_shader_path
+		//an empty path goes back to cpu recorded draws, false if the device cannot draw indirectly with first instance
+		//adding or removing objects waits for the device while gpu driven
+		bool set_gpu_driven(std::string cull_shader_path);
+		const bool gpu_driven() const { return indirect != nullptr; }
+		//gpu driven layers only, objects visible in the last frame are drawn depth only from the current view before culling
+		//the rest is tested against the depth pyramid of that pass, reduced by the compiled hiz.comp at downsample_shader_path
+		//an empty path disables it, false if the layer is not gpu driven
+		bool set_occlusion_culling(std::string downsample_shader_path);
+		const bool occlusion_culling() const { return pyramid != nullptr; }
+		//all materials share one set 1 of every texture and a material buffer, draws push their material index instead of binding a set
+		//the compiled fragment shader at fragment_shader_path replaces the layer's one while enabled, an empty path goes back to a set per material
+		//false if the device lacks descriptor indexing
+		bool set_bindless_materials(std::string fragment_shader_path);
+		const bool bindless_materials() const { return bindless != nullptr; }
+
+		//draws of cpu recorded chunks are sorted by pipeline, material, vertex buffer and depth
+		//totals of the last recording of every chunk, gpu driven layers report nothing
+		const DrawList::Stats draw_stats() const;
+
+		//world space mesh bounds shared by culling and the queries below, items are mesh indices across all objects
+		//refitted for objects whose transform or instances changed
+		const BVH& bvh();
+		Model* mesh_object(uint32_t mesh) const;
+		//nearest object whose mesh bounds the ray enters, nullptr if none
+		Model* pick(glm::vec3 origin, glm::vec3 direction, float* distance = nullptr);
+		//objects with mesh bounds overlapping the box
+		std::vector<Model*> query(glm::vec3 min, glm::vec3 max);
 
 		void set_projection(glm::mat4 projection) { this->proj = projection; }
 		void set_camera(Camera * camera) { this->camera = camera; }
@@ -56,6 +122,7 @@ namespace SVL
 		std::string vertex_shader_path;
 		std::string fragment_shader_path;
 		SVLTools::PipelineType pipeline_type;
+		const TransformSource transform_source;
 
 		std::vector<SVL::Model*> models;
 
@@ -67,19 +134,79 @@ namespace SVL
 		Texture* environment = nullptr;
 		Texture* dummy_env;
 
-		VkDescriptorPool vk_descriptor_pool = VK_NULL_HANDLE;
-		VkDescriptorSetLayout ubo_descriptor_set_layout = VK_NULL_HANDLE;
+		DescriptorAllocator* vk_descriptor_allocator = nullptr;
+		VkDescriptorSetLayout scene_descriptor_set_layout = VK_NULL_HANDLE;
 		VkDescriptorSetLayout material_descriptor_set_layout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout object_descriptor_set_layout = VK_NULL_HANDLE;
+
+		UniformPool::Slot scene_uniform_slot;
+		VkDescriptorBufferInfo scene_uniform_descriptor{};
+		VkDescriptorSet scene_descriptor_set = VK_NULL_HANDLE;
+
+		//bound at set 2 for push constant transforms and gpu driven draws, the shaders still declare the object set
+		UniformPool::Slot fallback_object_slot;
+		VkDescriptorBufferInfo fallback_object_descriptor{};
+		VkDescriptorSet fallback_object_descriptor_set = VK_NULL_HANDLE;
+
+		//single identity transform at binding 1 for models drawn without instances
+		VkBuffer identity_instance_buffer = VK_NULL_HANDLE;
+		Allocation identity_instance_allocation;
 		VkPipelineLayout vk_pipeline_layout = VK_NULL_HANDLE;
 
-		SVL::Pipeline* vk_pipeline;
+		//layouts, modules and pipelines are shared through the renderer pipeline registry
+		std::shared_ptr<SVL::Pipeline> vk_pipeline;
 		VkShaderModule vertex_shader_module = VK_NULL_HANDLE;
 		VkShaderModule fragment_shader_module = VK_NULL_HANDLE;
 
-		SVL::Pipeline* vk_blend_pipeline;
+		std::shared_ptr<SVL::Pipeline> vk_blend_pipeline;
+
+		std::vector<bool> dirty; //per frame in flight
+
+		bool culling = false;
+		BVH mesh_bvh; //rebuilt when models change, refitted when they move
+		bool mesh_bvh_built = false;
+		std::vector<uint8_t> mesh_visible;
+		std::vector<uint32_t> mesh_offsets; //first mesh of each model, models.size() + 1 entries
+		std::vector<uint64_t> bounds_revisions; //model revisions the world bounds were computed with
+		void update_bounds();
+		void update_visibility(const glm::mat4& view);
+
+		IndirectDraws* indirect = nullptr;
+		Frustum view_frustum; //of the last update_uniforms, for the gpu cull pass
+		glm::mat4 view_projection;
+
+		DepthPyramid* pyramid = nullptr;
+		std::shared_ptr<SVL::Pipeline> vk_depth_pipeline; //vertex stage only, for the pyramid pass
+
+		BindlessMaterials* bindless = nullptr; //replaces the material sets and layout while set
+		VkShaderModule bindless_fragment_shader_module = VK_NULL_HANDLE;
+
+		//range of models recorded into its own secondaries, one command pool per chunk
+		struct Chunk
+		{
+			VkCommandPool command_pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> command_buffers; //per frame in flight
+			uint32_t first = 0;
+			uint32_t count = 0;
+			std::vector<uint64_t> revisions; //per frame in flight, model revisions at the last recording
+			DrawList draws; //reused between recordings
+			DrawList::Stats stats;
+		};
+		std::vector<Chunk> chunks;
+		Chunk indirect_chunk; //all draws of a gpu driven layer, recorded only when the batches change
+
+		void create_chunk(Chunk& chunk);
+		void split_chunks(); //reuses existing chunks, new ones only when the layer grows
+		void destroy_chunks();
+		void record_chunk(Chunk& chunk, VkCommandBufferInheritanceInfo inheritance_info, uint32_t index);
+		//also stores the current revision, pushed transforms count only for push constant transforms
+		bool chunk_outdated(Chunk& chunk, uint32_t index);
 
 		void create_descriptors();
 		void destroy_descriptors();
+		//object and material sets, or bindless material entries
+		void create_object_descriptors(Model* object);
+		void destroy_object_descriptors(Model* object);
 
 		void create_pipeline();
 		void destroy_pipeline();
@@ -6,10 +6,13 @@
 #include <glm/glm.hpp>
 #include <string>
 
+#include "material_table.h"
+
 namespace SVL
 {
 	class Renderer;
 	class Texture;
+	//copies share the entry in the renderer material table
 	class DLLDIR Material
 	{
 	public:
@@ -38,20 +41,19 @@ namespace SVL
 		Material(const Renderer& renderer, MaterialTextures textures, MaterialProperties properties);
 		~Material();
 
+		//writes the properties to the table entry
 		void update();
 
-		struct
-		{
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
-			uint32_t size;
-		} material_data;
+		const MaterialTable::Handle& entry() const { return vk_entry; }
+		//set 1 binding 0
+		const VkDescriptorBufferInfo descriptor() const;
 
-		VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE;
+		VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE; //null in bindless layers
+		uint32_t bindless_index = UINT32_MAX; //in the BindlessMaterials of the layer, pushed as the material index
 		std::string diffuse_filename = "";
 	private:
 		const class Renderer& vk_renderer;
+		MaterialTable::Handle vk_entry;
 		bool del = true;
 	};
 }
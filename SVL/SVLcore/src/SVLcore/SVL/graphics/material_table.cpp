@@ -0,0 +1,114 @@
+#include "material_table.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include <algorithm>
+#include <cstring>
+
+#include "renderer.h"
+#include "tools.h"
+
+SVL::MaterialTable::MaterialTable(const Renderer& renderer, uint32_t entry_size, uint32_t entries_per_page)
+	: vk_renderer(renderer), entry_size(entry_size), entries_per_page(entries_per_page)
+{
+	const VkPhysicalDeviceLimits& limits = vk_renderer.properties().limits;
+	VkDeviceSize alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+	entry_stride = (entry_size + alignment - 1) / alignment * alignment;
+}
+
+SVL::MaterialTable::~MaterialTable()
+{
+	for (Page& page : pages)
+		SVLTools::destroy_buffer(vk_renderer, page.buffer, page.allocation);
+}
+
+SVL::MaterialTable::Handle SVL::MaterialTable::allocate(const void* data, size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Handle handle;
+	for (uint32_t i = 0; i < pages.size(); i++)
+	{
+		if (!pages[i].free_entries.empty())
+		{
+			handle.page = i;
+			break;
+		}
+	}
+	if (handle.page == UINT32_MAX)
+	{
+		Page page;
+		SVLTools::create_buffer(vk_renderer, entry_stride * entries_per_page, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &page.buffer, &page.allocation);
+		page.references.assign(entries_per_page, 0);
+		//popped from the back, hand out low entries first
+		for (uint32_t i = entries_per_page; i > 0; i--)
+			page.free_entries.push_back(i - 1);
+		pages.push_back(page);
+		handle.page = (uint32_t)pages.size() - 1;
+	}
+
+	Page& page = pages[handle.page];
+	handle.index = page.free_entries.back();
+	page.free_entries.pop_back();
+	page.references[handle.index] = 1;
+
+	uint8_t* entry = static_cast<uint8_t*>(page.allocation.mapped) + handle.index * entry_stride;
+	memset(entry, 0, entry_size);
+	memcpy(entry, data, std::min<size_t>(size, entry_size));
+	return handle;
+}
+
+void SVL::MaterialTable::retain(const Handle& handle)
+{
+	if (handle.page == UINT32_MAX)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	pages[handle.page].references[handle.index]++;
+}
+
+void SVL::MaterialTable::release(Handle& handle)
+{
+	if (handle.page == UINT32_MAX)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Page& page = pages[handle.page];
+	if (--page.references[handle.index] == 0)
+		page.free_entries.push_back(handle.index);
+	handle = Handle();
+}
+
+void SVL::MaterialTable::write(const Handle& handle, const void* data, size_t size)
+{
+	if (handle.page == UINT32_MAX)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	uint8_t* entry = static_cast<uint8_t*>(pages[handle.page].allocation.mapped) + handle.index * entry_stride;
+	memcpy(entry, data, std::min<size_t>(size, entry_size));
+}
+
+const VkDescriptorBufferInfo SVL::MaterialTable::descriptor(const Handle& handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	VkDescriptorBufferInfo info{};
+	info.buffer = pages[handle.page].buffer;
+	info.offset = handle.index * entry_stride;
+	info.range = entry_size;
+	return info;
+}
+
+const VkBuffer SVL::MaterialTable::buffer(uint32_t page) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pages[page].buffer;
+}
+
+const uint32_t SVL::MaterialTable::entries_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t count = 0;
+	for (const Page& page : pages)
+		count += entries_per_page - (uint32_t)page.free_entries.size();
+	return count;
+}
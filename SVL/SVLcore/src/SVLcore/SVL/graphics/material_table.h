@@ -0,0 +1,67 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+
+#include "memory.h"
+
+namespace SVL
+{
+	class Renderer;
+	//material parameters of the renderer packed into shared, persistently mapped buffers, materials keep a handle to their entry
+	//entries are reference counted, copies of a material share the handle and its entry
+	//a page holds entries_per_page entries, entries are aligned for uniform and storage buffer offsets
+	class DLLDIR MaterialTable
+	{
+	public:
+		struct Handle
+		{
+			uint32_t page = UINT32_MAX;
+			uint32_t index = 0;
+		};
+
+		MaterialTable(const Renderer& renderer, uint32_t entry_size, uint32_t entries_per_page = MATERIAL_TABLE_PAGE_ENTRIES);
+		~MaterialTable();
+
+		MaterialTable(const MaterialTable&) = delete;
+		MaterialTable& operator=(const MaterialTable&) = delete;
+		MaterialTable(MaterialTable&&) = delete;
+		MaterialTable& operator=(MaterialTable&&) = delete;
+
+		//the new entry holds one reference and size bytes of data
+		Handle allocate(const void* data, size_t size);
+		void retain(const Handle& handle);
+		//frees the entry with its last reference, which must no longer be used by frames in flight
+		void release(Handle& handle);
+		//written in place, frames in flight see the change like any other mapped uniform
+		void write(const Handle& handle, const void* data, size_t size);
+
+		//the entry alone, bindable as a uniform or storage buffer
+		const VkDescriptorBufferInfo descriptor(const Handle& handle) const;
+		//pages are never destroyed or moved
+		const VkBuffer buffer(uint32_t page) const;
+		const VkDeviceSize stride() const { return entry_stride; }
+		const uint32_t entries_count() const;
+	private:
+		struct Page
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			Allocation allocation;
+			std::vector<uint32_t> references; //per entry, 0 for free entries
+			std::vector<uint32_t> free_entries;
+		};
+
+		const class Renderer& vk_renderer;
+		const uint32_t entry_size;
+		const uint32_t entries_per_page;
+		VkDeviceSize entry_stride;
+		std::vector<Page> pages;
+		mutable std::mutex mutex;
+	};
+}
+
+#endif // !MATERIAL_TABLE_H
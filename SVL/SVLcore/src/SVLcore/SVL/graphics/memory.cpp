@@ -0,0 +1,286 @@
+#include "memory.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include "renderer.h"
+
+#include <algorithm>
+#include <string>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+SVL::MemoryAllocator::MemoryAllocator(const Renderer& renderer, VkDeviceSize block_size)
+	: vk_renderer(renderer), block_size(block_size)
+{
+	vkGetPhysicalDeviceMemoryProperties(vk_renderer.physical_device(), &memory_properties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(vk_renderer.physical_device(), &properties);
+	non_coherent_atom_size = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+SVL::MemoryAllocator::~MemoryAllocator()
+{
+	if (memory_stats.allocation_count != 0)
+		Log("SVL WARNING: " + std::to_string(memory_stats.allocation_count) + " device memory allocations were not freed.");
+
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i].memory != VK_NULL_HANDLE)
+			destroy_block(i);
+	}
+}
+
+SVL::Allocation SVL::MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint32_t memory_type = find_memory_type(requirements.memoryTypeBits, properties);
+	VkMemoryPropertyFlags type_flags = memory_properties.memoryTypes[memory_type].propertyFlags;
+
+	VkDeviceSize size = requirements.size;
+	VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+	//flush ranges of non coherent memory must be multiples of nonCoherentAtomSize
+	if ((type_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(type_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		alignment = align_up(alignment, non_coherent_atom_size);
+		size = align_up(size, non_coherent_atom_size);
+	}
+
+	uint32_t block_index = UINT32_MAX;
+	VkDeviceSize offset = 0;
+	if (!sub_allocation || size > preferred_block_size(memory_type) / 2)
+	{
+		block_index = create_block(memory_type, size, linear, true);
+		blocks[block_index].free_ranges.clear();
+	}
+	else
+	{
+		for (uint32_t i = 0; i < blocks.size(); i++)
+		{
+			Block& block = blocks[i];
+			if (block.memory == VK_NULL_HANDLE || block.dedicated || block.memory_type != memory_type || block.linear != linear)
+				continue;
+			if (try_allocate(block, size, alignment, offset))
+			{
+				block_index = i;
+				break;
+			}
+		}
+		if (block_index == UINT32_MAX)
+		{
+			block_index = create_block(memory_type, preferred_block_size(memory_type), linear, false);
+			if (!try_allocate(blocks[block_index], size, alignment, offset))
+				Error("SVL ERROR: failed to sub-allocate device memory.");
+		}
+	}
+
+	Block& block = blocks[block_index];
+	block.allocations++;
+
+	Allocation allocation;
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.block = block_index;
+	if (block.mapped != nullptr)
+		allocation.mapped = static_cast<uint8_t*>(block.mapped) + offset;
+
+	memory_stats.allocation_count++;
+	memory_stats.total_allocations++;
+	memory_stats.used_bytes += size;
+
+	return allocation;
+}
+
+void SVL::MemoryAllocator::free(Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE || allocation.block == UINT32_MAX)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Block& block = blocks[allocation.block];
+	if (block.memory != allocation.memory)
+		Error("SVL ERROR: freeing allocation from a destroyed memory block.");
+
+	memory_stats.allocation_count--;
+	memory_stats.used_bytes -= allocation.size;
+	block.allocations--;
+
+	if (block.dedicated)
+	{
+		destroy_block(allocation.block);
+	}
+	else
+	{
+		//insert and merge with neighbours
+		Range range{ allocation.offset, allocation.size };
+		auto it = std::lower_bound(block.free_ranges.begin(), block.free_ranges.end(), range, [](const Range& a, const Range& b) { return a.offset < b.offset; });
+		it = block.free_ranges.insert(it, range);
+		if (it + 1 != block.free_ranges.end() && it->offset + it->size == (it + 1)->offset)
+		{
+			it->size += (it + 1)->size;
+			block.free_ranges.erase(it + 1);
+		}
+		if (it != block.free_ranges.begin() && (it - 1)->offset + (it - 1)->size == it->offset)
+		{
+			(it - 1)->size += it->size;
+			block.free_ranges.erase(it);
+		}
+
+		//keep a single empty block per memory type around to avoid allocation ping-pong
+		if (block.allocations == 0)
+		{
+			for (uint32_t i = 0; i < blocks.size(); i++)
+			{
+				const Block& other = blocks[i];
+				if (i != allocation.block && other.memory != VK_NULL_HANDLE && !other.dedicated && other.allocations == 0 && other.memory_type == block.memory_type && other.linear == block.linear)
+				{
+					destroy_block(allocation.block);
+					break;
+				}
+			}
+		}
+	}
+
+	allocation = Allocation();
+}
+
+void SVL::MemoryAllocator::flush(const Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	uint32_t memory_type;
+	VkDeviceSize size;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		memory_type = blocks[allocation.block].memory_type;
+		size = blocks[allocation.block].size;
+	}
+	if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		return;
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = allocation.offset;
+	range.size = allocation.offset + allocation.size >= size ? VK_WHOLE_SIZE : allocation.size;
+	ErrorCheck(vkFlushMappedMemoryRanges(vk_renderer.device(), 1, &range));
+}
+
+void SVL::MemoryAllocator::bind_buffer(VkBuffer buffer, const Allocation& allocation)
+{
+	ErrorCheck(vkBindBufferMemory(vk_renderer.device(), buffer, allocation.memory, allocation.offset));
+}
+
+void SVL::MemoryAllocator::bind_image(VkImage image, const Allocation& allocation)
+{
+	ErrorCheck(vkBindImageMemory(vk_renderer.device(), image, allocation.memory, allocation.offset));
+}
+
+void SVL::MemoryAllocator::set_sub_allocation(bool enable)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	sub_allocation = enable;
+}
+
+const SVL::MemoryStats SVL::MemoryAllocator::stats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return memory_stats;
+}
+
+uint32_t SVL::MemoryAllocator::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+	{
+		if ((type_filter & (1 << i)) &&
+			((memory_properties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+	}
+	Error("SVL ERROR: failed to find suitable memory type");
+	return 0;
+}
+
+VkDeviceSize SVL::MemoryAllocator::preferred_block_size(uint32_t memory_type) const
+{
+	VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+	//small heaps (e.g. 256MB host visible device local) would be exhausted by a few full blocks
+	if (heap_size <= 1024ull * 1024 * 1024)
+		return std::min(block_size, heap_size / 8);
+	return block_size;
+}
+
+uint32_t SVL::MemoryAllocator::create_block(uint32_t memory_type, VkDeviceSize size, bool linear, bool dedicated)
+{
+	Block block;
+	block.size = size;
+	block.memory_type = memory_type;
+	block.linear = linear;
+	block.dedicated = dedicated;
+	block.free_ranges.push_back({ 0, size });
+
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = size;
+	allocate_info.memoryTypeIndex = memory_type;
+	ErrorCheck(vkAllocateMemory(vk_renderer.device(), &allocate_info, nullptr, &block.memory));
+
+	if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		ErrorCheck(vkMapMemory(vk_renderer.device(), block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped));
+
+	memory_stats.block_count++;
+	memory_stats.total_block_allocations++;
+	memory_stats.reserved_bytes += size;
+
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i].memory == VK_NULL_HANDLE)
+		{
+			blocks[i] = block;
+			return i;
+		}
+	}
+	blocks.push_back(block);
+	return blocks.size() - 1;
+}
+
+void SVL::MemoryAllocator::destroy_block(uint32_t index)
+{
+	Block& block = blocks[index];
+	if (block.mapped != nullptr)
+		vkUnmapMemory(vk_renderer.device(), block.memory);
+	vkFreeMemory(vk_renderer.device(), block.memory, nullptr);
+
+	memory_stats.block_count--;
+	memory_stats.reserved_bytes -= block.size;
+
+	block = Block();
+}
+
+bool SVL::MemoryAllocator::try_allocate(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	for (size_t i = 0; i < block.free_ranges.size(); i++)
+	{
+		Range range = block.free_ranges[i];
+		VkDeviceSize aligned = align_up(range.offset, alignment);
+		VkDeviceSize padding = aligned - range.offset;
+		if (range.size < padding + size)
+			continue;
+
+		offset = aligned;
+		VkDeviceSize tail = range.size - padding - size;
+
+		block.free_ranges.erase(block.free_ranges.begin() + i);
+		if (tail > 0)
+			block.free_ranges.insert(block.free_ranges.begin() + i, { aligned + size, tail });
+		if (padding > 0)
+			block.free_ranges.insert(block.free_ranges.begin() + i, { range.offset, padding });
+		return true;
+	}
+	return false;
+}
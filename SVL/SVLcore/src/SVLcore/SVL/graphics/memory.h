@@ -0,0 +1,91 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+
+namespace SVL
+{
+	struct Allocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr; //only for host visible memory
+		uint32_t block = UINT32_MAX;
+	};
+
+	struct MemoryStats
+	{
+		uint32_t block_count = 0; //live vkAllocateMemory allocations
+		uint32_t allocation_count = 0; //live sub-allocations
+		VkDeviceSize reserved_bytes = 0; //size of all blocks
+		VkDeviceSize used_bytes = 0; //size of all sub-allocations
+		uint64_t total_block_allocations = 0;
+		uint64_t total_allocations = 0;
+	};
+
+	class Renderer;
+	class DLLDIR MemoryAllocator
+	{
+	public:
+		MemoryAllocator(const Renderer& renderer, VkDeviceSize block_size = MEMORY_BLOCK_SIZE);
+		~MemoryAllocator();
+
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+		MemoryAllocator(MemoryAllocator&&) = delete;
+		MemoryAllocator& operator=(MemoryAllocator&&) = delete;
+
+		//linear - buffers and linear tiled images, kept apart from optimal images because of bufferImageGranularity
+		Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+		void free(Allocation& allocation);
+		void flush(const Allocation& allocation);
+
+		void bind_buffer(VkBuffer buffer, const Allocation& allocation);
+		void bind_image(VkImage image, const Allocation& allocation);
+
+		//false - every allocation gets its own vkAllocateMemory, used to compare against sub-allocation
+		void set_sub_allocation(bool enable);
+		const MemoryStats stats();
+	private:
+		struct Range
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			void* mapped = nullptr;
+			uint32_t memory_type = 0;
+			uint32_t allocations = 0;
+			bool linear = false;
+			bool dedicated = false;
+			std::vector<Range> free_ranges; //sorted by offset
+		};
+
+		const class Renderer& vk_renderer;
+		const VkDeviceSize block_size;
+		VkDeviceSize non_coherent_atom_size = 1;
+		VkPhysicalDeviceMemoryProperties memory_properties;
+
+		std::vector<Block> blocks;
+		MemoryStats memory_stats;
+		bool sub_allocation = true;
+		std::mutex mutex;
+
+		uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+		VkDeviceSize preferred_block_size(uint32_t memory_type) const;
+
+		uint32_t create_block(uint32_t memory_type, VkDeviceSize size, bool linear, bool dedicated);
+		void destroy_block(uint32_t block);
+		bool try_allocate(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+	};
+}
+
+#endif // !MEMORY_H
@@ -0,0 +1,19 @@
+#include "mesh.h"
+
+#include <algorithm>
+
+void SVL::Mesh::compute_bounds()
+{
+	if (vertices.empty())
+	{
+		bounds_min = bounds_max = glm::vec3(0.0f);
+		return;
+	}
+
+	bounds_min = bounds_max = vertices[0].position;
+	for (const Vertex3D& vertex : vertices)
+	{
+		bounds_min = glm::min(bounds_min, vertex.position);
+		bounds_max = glm::max(bounds_max, vertex.position);
+	}
+}
\ No newline at end of file
@@ -15,6 +15,12 @@ namespace SVL
 		uint64_t vertex_base = 0;
 		uint64_t index_base = 0;
 		uint32_t material_id = 0;
+
+		//local space, filled by compute_bounds when the model is created
+		glm::vec3 bounds_min = glm::vec3(0.0f);
+		glm::vec3 bounds_max = glm::vec3(0.0f);
+
+		void compute_bounds();
 	};
 }
 #endif
@@ -9,10 +9,15 @@
 #include "texture.h"
 #include "light.h"
 #include "renderer.h"
+#include "upload.h"
+#include "descriptor.h"
+#include "draw_list.h"
 
 #include <chrono>
 #include <unordered_map>
 #include <algorithm>
+#include <cstring>
+#include <cstddef>
 #include <glm/gtc/matrix_transform.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/rotate_vector.hpp>
@@ -20,15 +25,10 @@
 SVL::Model::Model(const Renderer& renderer, VkCommandPool command_pool, SVL::Mesh & mesh, SVL::Texture & texture)
 	:vk_renderer(renderer), model(glm::mat4(1.0f))
 {
-	vk_uniform_data.size = sizeof(UniformBufferObject);
-
-	SVLTools::create_buffer(vk_renderer.device(), vk_renderer.physical_device(), vk_uniform_data.size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vk_uniform_data.buffer, &vk_uniform_data.memory);
-
-	vk_uniform_data.descriptor.buffer = vk_uniform_data.buffer;
-	vk_uniform_data.descriptor.offset = 0;
-	vk_uniform_data.descriptor.range = vk_uniform_data.size;
+	create_uniform_buffer();
 
 	meshes.push_back(mesh);
+	meshes.back().compute_bounds();
 
 	Material::MaterialTextures textures;
 	textures.diffuse = &texture;
@@ -38,23 +38,9 @@ SVL::Model::Model(const Renderer& renderer, VkCommandPool command_pool, SVL::Mes
 	std::vector<SVL::Vertex3D> vertices = mesh.vertices;
 	std::vector<uint32_t> indices = mesh.indices;
 
-	vk_vertices.size = sizeof(vertices[0]) * vertices.size();
-	SVLTools::create_buffer_and_memory(vk_renderer.device(), vk_renderer.physical_device(), vk_renderer.queue(), command_pool, vk_vertices.size, vertices.data(),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vk_vertices.buffer, vk_vertices.memory
-	);
-
-	vk_indices.size = sizeof(indices[0]) * indices.size();
-	SVLTools::create_buffer_and_memory(vk_renderer.device(), vk_renderer.physical_device(), vk_renderer.queue(), command_pool, vk_indices.size, indices.data(),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vk_indices.buffer, vk_indices.memory
-	);
+	UploadBatch upload(vk_renderer);
+	vk_geometry = vk_renderer.geometry().allocate(upload, vertices, indices);
+	upload.submit();
 
 	_destroy = false;
 	_can_render = true;
@@ -63,18 +49,36 @@ SVL::Model::Model(const Renderer& renderer, VkCommandPool command_pool, SVL::Mes
 SVL::Model::Model(const Renderer& renderer, VkCommandPool command_pool, std::vector<Mesh> meshes, std::vector<Material> materials)
 	:vk_renderer(renderer), meshes(meshes), materials(materials), model(glm::mat4(1.0f))
 {
-	vk_uniform_data.size = sizeof(UniformBufferObject);
+	UploadBatch upload(vk_renderer);
+	create(upload);
+	upload.submit();
+}
 
-	SVLTools::create_buffer(vk_renderer.device(), vk_renderer.physical_device(), vk_uniform_data.size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vk_uniform_data.buffer, &vk_uniform_data.memory);
+SVL::Model::Model(const Renderer& renderer, UploadBatch& upload, std::vector<Mesh> meshes, std::vector<Material> materials)
+	:vk_renderer(renderer), meshes(meshes), materials(materials), model(glm::mat4(1.0f))
+{
+	create(upload);
+}
 
-	vk_uniform_data.descriptor.buffer = vk_uniform_data.buffer;
-	vk_uniform_data.descriptor.offset = 0;
-	vk_uniform_data.descriptor.range = vk_uniform_data.size;
+SVL::Model::~Model()
+{
+	vk_renderer.geometry().free(vk_geometry);
+	vk_renderer.uniforms().free(vk_uniform_data.slot);
+	if (vk_instances.buffer != VK_NULL_HANDLE)
+		SVLTools::destroy_buffer(vk_renderer, vk_instances.buffer, vk_instances.allocation);
+}
+
+void SVL::Model::create(UploadBatch& upload)
+{
+	create_uniform_buffer();
 
 
 	std::vector<SVL::Vertex3D> vertices;
 	std::vector<uint32_t> indices;
 
+	for (Mesh& mesh : meshes)
+		mesh.compute_bounds();
+
 	uint32_t offset = 0;
 	for (Mesh mesh : meshes)
 	{
@@ -84,83 +88,52 @@ SVL::Model::Model(const Renderer& renderer, VkCommandPool command_pool, std::vec
 		offset += mesh.indices.size();
 	}
 
-	vk_vertices.size = sizeof(vertices[0]) * vertices.size();
-	SVLTools::create_buffer_and_memory(vk_renderer.device(), vk_renderer.physical_device(), vk_renderer.queue(), command_pool, vk_vertices.size, vertices.data(),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vk_vertices.buffer, vk_vertices.memory
-		);
-
-	vk_indices.size = sizeof(indices[0]) * indices.size();
-	SVLTools::create_buffer_and_memory(vk_renderer.device(), vk_renderer.physical_device(), vk_renderer.queue(), command_pool, vk_indices.size, indices.data(),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vk_indices.buffer, vk_indices.memory
-	);
+	vk_geometry = vk_renderer.geometry().allocate(upload, vertices, indices);
 
 	_can_render = true;
 }
 
-SVL::Model::~Model()
+void SVL::Model::create_uniform_buffer()
 {
-	vkFreeMemory(vk_renderer.device(), vk_indices.memory, nullptr);
-	vkDestroyBuffer(vk_renderer.device(), vk_indices.buffer, nullptr);
+	vk_uniform_data.slot = vk_renderer.uniforms().allocate(sizeof(ObjectUniforms));
+	vk_uniform_data.dirty.assign(vk_renderer.frames_in_flight(), true);
 
-	vkFreeMemory(vk_renderer.device(), vk_vertices.memory, nullptr);
-	vkDestroyBuffer(vk_renderer.device(), vk_vertices.buffer, nullptr);
-
-	vkFreeMemory(vk_renderer.device(), vk_uniform_data.memory, nullptr);
-	vkDestroyBuffer(vk_renderer.device(), vk_uniform_data.buffer, nullptr);
+	vk_uniform_data.descriptor.buffer = vk_uniform_data.slot.buffer;
+	vk_uniform_data.descriptor.offset = 0;
+	vk_uniform_data.descriptor.range = vk_uniform_data.slot.size;
 }
 
-void SVL::Model::create_descriptor_sets(VkDescriptorPool descriptor_pool, std::array<VkDescriptorSetLayout, 2> layouts, Texture* environment)
+void SVL::Model::create_descriptor_sets(DescriptorAllocator& allocator, std::array<VkDescriptorSetLayout, 2> layouts, Texture* environment)
 {
-	//set0
-	VkDescriptorSetAllocateInfo allocate_info = {};
-	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocate_info.descriptorPool = descriptor_pool;
-	allocate_info.descriptorSetCount = 1;
-	allocate_info.pSetLayouts = &layouts[0];
-	ErrorCheck(vkAllocateDescriptorSets(vk_renderer.device(), &allocate_info, &vk_descriptor_set));
-	//ubo
-	std::vector<VkWriteDescriptorSet> descriptor_writes = {};
-	VkWriteDescriptorSet uniform_set{};
-	uniform_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	uniform_set.dstSet = vk_descriptor_set;
-	uniform_set.dstBinding = 0;
-	uniform_set.dstArrayElement = 0;
-	uniform_set.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uniform_set.descriptorCount = 1;
-	uniform_set.pBufferInfo = &vk_uniform_data.descriptor;
-	descriptor_writes.push_back(uniform_set);
-	//ubo in fragment
-	uniform_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	uniform_set.dstSet = vk_descriptor_set;
-	uniform_set.dstBinding = 1;
-	uniform_set.dstArrayElement = 0;
-	uniform_set.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uniform_set.descriptorCount = 1;
-	uniform_set.pBufferInfo = &vk_uniform_data.descriptor;
-	descriptor_writes.push_back(uniform_set);
-
-	vkUpdateDescriptorSets(vk_renderer.device(), descriptor_writes.size(), descriptor_writes.data(), 0, nullptr);
+	//set2
+	if (layouts[0] != VK_NULL_HANDLE)
+	{
+		if (vk_descriptor_set == VK_NULL_HANDLE)
+			vk_descriptor_set = allocator.allocate(layouts[0]);
+		//object ubo
+		VkWriteDescriptorSet uniform_set{};
+		uniform_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		uniform_set.dstSet = vk_descriptor_set;
+		uniform_set.dstBinding = 0;
+		uniform_set.dstArrayElement = 0;
+		uniform_set.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		uniform_set.descriptorCount = 1;
+		uniform_set.pBufferInfo = &vk_uniform_data.descriptor;
+
+		vkUpdateDescriptorSets(vk_renderer.device(), 1, &uniform_set, 0, nullptr);
+	}
 
+	//bindless layers bind a single set 1 for all materials
+	if (layouts[1] == VK_NULL_HANDLE) return;
 	for (Material& material : materials)
 	{
 		//set1
-		VkDescriptorSetAllocateInfo allocate_info = {};
-		allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocate_info.descriptorPool = descriptor_pool;
-		allocate_info.descriptorSetCount = 1;
-		allocate_info.pSetLayouts = &layouts[1];
-		ErrorCheck(vkAllocateDescriptorSets(vk_renderer.device(), &allocate_info, &material.vk_descriptor_set));
+		if (material.vk_descriptor_set == VK_NULL_HANDLE)
+			material.vk_descriptor_set = allocator.allocate(layouts[1]);
 		//material
 		std::vector<VkWriteDescriptorSet> descriptor_writes = {};
 		VkWriteDescriptorSet descriptor_write{};
+		VkDescriptorBufferInfo material_descriptor = material.descriptor();
 
 		descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptor_write.dstSet = material.vk_descriptor_set;
@@ -168,7 +141,7 @@ void SVL::Model::create_descriptor_sets(VkDescriptorPool descriptor_pool, std::a
 		descriptor_write.dstArrayElement = 0;
 		descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		descriptor_write.descriptorCount = 1;
-		descriptor_write.pBufferInfo = &material.material_data.descriptor;
+		descriptor_write.pBufferInfo = &material_descriptor;
 		descriptor_writes.push_back(descriptor_write);
 
 		descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -233,45 +206,156 @@ void SVL::Model::create_descriptor_sets(VkDescriptorPool descriptor_pool, std::a
 	}
 }
 
-void SVL::Model::render(VkCommandBuffer command_buffer, std::array<VkPipeline, 2> pipelines, VkPipelineLayout pipeline_layout)
+void SVL::Model::destroy_descriptor_sets(DescriptorAllocator& allocator)
+{
+	for (Material& material : materials)
+		allocator.free(material.vk_descriptor_set);
+	allocator.free(vk_descriptor_set);
+}
+
+void SVL::Model::render(VkCommandBuffer command_buffer, std::array<VkPipeline, 2> pipelines, VkPipelineLayout pipeline_layout, uint32_t frame, VkBuffer identity_instance, bool push_constants, const uint8_t* visible_meshes)
 {
-	if (!_can_render) return;
-	VkDeviceSize offsets[] = { 0 };
+	if (!_can_render || vk_geometry.page == UINT32_MAX) return;
+	uint32_t instance_count = instances_count();
+	if (instance_count == 0) return;
+	uint32_t dynamic_offset = vk_uniform_data.slot.dynamic_offset(frame);
+
+	GeometryPool& geometry = vk_renderer.geometry();
+	VkBuffer vertex_buffers[] = { geometry.vertex_buffer(vk_geometry.page), identity_instance };
+	VkDeviceSize offsets[] = { 0, 0 };
+	if (vk_instances.enabled)
+	{
+		vertex_buffers[1] = vk_instances.buffer;
+		offsets[1] = (VkDeviceSize)frame * vk_instances.capacity * sizeof(glm::mat4);
+	}
+	vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+	vkCmdBindIndexBuffer(command_buffer, geometry.index_buffer(vk_geometry.page), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[0]);//defined pipeline
+
+	ObjectPushConstants push{};
+	push.model = model;
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (visible_meshes != nullptr && !visible_meshes[i])
+			continue;
+		const Material& material = materials[meshes[i].material_id];
+		bool bindless = material.vk_descriptor_set == VK_NULL_HANDLE;
+		if (push_constants)
+		{
+			push.material_index = bindless ? material.bindless_index : meshes[i].material_id;
+			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectPushConstants), &push);
+			if (!bindless)
+				vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 1, &material.vk_descriptor_set, 0, nullptr);
+		}
+		else if (bindless)
+		{
+			//set 1 stays bound, only the material index is pushed
+			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, offsetof(ObjectPushConstants, material_index), sizeof(uint32_t), &material.bindless_index);
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 2, 1, &vk_descriptor_set, 1, &dynamic_offset);
+		}
+		else
+		{
+			VkDescriptorSet descriptor_sets[2];
+			descriptor_sets[0] = material.vk_descriptor_set;
+			descriptor_sets[1] = vk_descriptor_set;
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 1, 2, descriptor_sets, 1, &dynamic_offset);
+		}
+		vkCmdDrawIndexed(command_buffer, meshes[i].indices.size(), instance_count, vk_geometry.first_index + meshes[i].index_base, vk_geometry.first_vertex + meshes[i].vertex_base, 0);
+	}
+}
 
-	vkCmdBindVertexBuffers(command_buffer, 0, 1, &vk_vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(command_buffer, vk_indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+void SVL::Model::add_draws(DrawList& list, std::array<VkPipeline, 2> pipelines, uint32_t frame, VkBuffer identity_instance, const glm::mat4& view, bool push_constants, const uint8_t* visible_meshes)
+{
+	if (!_can_render || vk_geometry.page == UINT32_MAX) return;
+	uint32_t instance_count = instances_count();
+	if (instance_count == 0) return;
+
+	DrawList::Draw draw;
+	draw.pipeline = pipelines[0];
+	draw.object = push_constants ? VK_NULL_HANDLE : vk_descriptor_set;
+	draw.object_offset = vk_uniform_data.slot.dynamic_offset(frame);
+	draw.vertices = vk_renderer.geometry().vertex_buffer(vk_geometry.page);
+	draw.instances = identity_instance;
+	if (vk_instances.enabled)
+	{
+		draw.instances = vk_instances.buffer;
+		draw.instances_offset = (VkDeviceSize)frame * vk_instances.capacity * sizeof(glm::mat4);
+	}
+	draw.indices = vk_renderer.geometry().index_buffer(vk_geometry.page);
+	draw.instance_count = instance_count;
+	draw.model = this;
 
+	glm::mat4 model_view = view * model;
 	for (size_t i = 0; i < meshes.size(); i++)
 	{
-		VkDescriptorSet descriptor_sets[2];
-		descriptor_sets[0] = vk_descriptor_set;
-		descriptor_sets[1] = materials[meshes[i].material_id].vk_descriptor_set;
-		
-		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[0]);//defined pipeline
-		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 2, descriptor_sets, 0, nullptr);
-		vkCmdDrawIndexed(command_buffer, meshes[i].indices.size(), 1, meshes[i].index_base, meshes[i].vertex_base, 0);
+		if (visible_meshes != nullptr && !visible_meshes[i])
+			continue;
+		const Mesh& mesh = meshes[i];
+		const Material& material = materials[mesh.material_id];
+		draw.material = material.vk_descriptor_set;
+		draw.material_index = material.vk_descriptor_set == VK_NULL_HANDLE ? material.bindless_index : mesh.material_id;
+		draw.index_count = (uint32_t)mesh.indices.size();
+		draw.first_index = vk_geometry.first_index + (uint32_t)mesh.index_base;
+		draw.vertex_offset = (int32_t)(vk_geometry.first_vertex + mesh.vertex_base);
+		draw.depth = -(model_view * glm::vec4((mesh.bounds_min + mesh.bounds_max) * 0.5f, 1.0f)).z;
+		list.add(draw);
 	}
 }
 
-void SVL::Model::update_uniform(glm::mat4 projection, glm::mat4 view, std::array<SVL::PointLight, 4> lights, glm::vec4 view_pos)
+void SVL::Model::update_uniform(uint32_t frame)
 {
-	UniformBufferObject ubo{};
-	
-	ubo.proj = projection;
-	ubo.view = view;
+	if (!vk_uniform_data.dirty[frame]) return;
+	vk_uniform_data.dirty[frame] = false;
+
+	//written in place, the slice stays mapped and the window keeps it free while recording this frame
+	ObjectUniforms& ubo = *static_cast<ObjectUniforms*>(vk_uniform_data.slot.data(frame));
 	ubo.model = model;
-	
-	std::copy(std::begin(lights), std::end(lights), std::begin(ubo.point_light));
+}
+
+void SVL::Model::update_instances(uint32_t frame)
+{
+	if (!vk_instances.enabled || vk_instances.transforms.empty() || !vk_instances.dirty[frame]) return;
+	vk_instances.dirty[frame] = false;
 
-	ubo.view_pos = view_pos * -1.0f;
+	uint8_t* slice = static_cast<uint8_t*>(vk_instances.allocation.mapped) + (size_t)frame * vk_instances.capacity * sizeof(glm::mat4);
+	memcpy(slice, vk_instances.transforms.data(), vk_instances.transforms.size() * sizeof(glm::mat4));
+}
 
-	void* data;
-	vkMapMemory(vk_renderer.device(), vk_uniform_data.memory, 0, sizeof(UniformBufferObject), 0, &data);
-	memcpy(data, &ubo, sizeof(UniformBufferObject));
-	vkUnmapMemory(vk_renderer.device(), vk_uniform_data.memory);
+void SVL::Model::set_instances(const std::vector<glm::mat4>& transforms)
+{
+	if (transforms.size() > vk_instances.capacity)
+	{
+		//recorded frames still read the old buffer
+		if (vk_instances.buffer != VK_NULL_HANDLE)
+		{
+			vk_renderer.wait_for_device();
+			SVLTools::destroy_buffer(vk_renderer, vk_instances.buffer, vk_instances.allocation);
+		}
+		vk_instances.capacity = std::max<uint32_t>((uint32_t)transforms.size(), vk_instances.capacity * 2);
+		SVLTools::create_buffer(vk_renderer, (VkDeviceSize)vk_instances.capacity * sizeof(glm::mat4) * vk_renderer.frames_in_flight(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &vk_instances.buffer, &vk_instances.allocation);
+		vk_draw_revision++;
+	}
+	if (!vk_instances.enabled || transforms.size() != vk_instances.transforms.size())
+		vk_draw_revision++;
+
+	vk_instances.enabled = true;
+	vk_instances.transforms = transforms;
+	vk_revision++; //bounds and gpu driven transforms follow the instances
+	vk_instances.dirty.assign(vk_renderer.frames_in_flight(), true);
+}
+
+void SVL::Model::clear_instances()
+{
+	if (!vk_instances.enabled) return;
+	vk_instances.enabled = false;
+	vk_instances.transforms.clear();
+	vk_draw_revision++;
 }
 
 void SVL::Model::set_ubo_model(glm::mat4 model)
 {
 	this->model = model;
+	vk_revision++;
+	vk_uniform_data.dirty.assign(vk_uniform_data.dirty.size(), true);
 }
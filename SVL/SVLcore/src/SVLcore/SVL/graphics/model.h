@@ -11,24 +11,34 @@
 #include "mesh.h"
 #include "material.h"
 #include "light.h"
+#include "memory.h"
+#include "uniform.h"
+#include "geometry.h"
 
 
 namespace SVL
 {
-	struct UniformBufferObject
+	//per object, set 2, scene wide data lives in the layer
+	struct ObjectUniforms
 	{
 		glm::mat4 model;
-		glm::mat4 view;
-		glm::mat4 proj;
-		glm::vec4 view_pos;
-		PointLight point_light[4];
+	};
+	//per draw, replaces set 2 on layers using PushConstantTransform
+	struct ObjectPushConstants
+	{
+		glm::mat4 model;
+		uint32_t material_index;
 	};
 	class Renderer;
+	class UploadBatch;
+	class DescriptorAllocator;
+	class DrawList;
 	class DLLDIR Model final
 	{
 	public:
 		Model(const Renderer& renderer, VkCommandPool command_pool, SVL::Mesh& mesh, SVL::Texture& texture);
 		Model(const Renderer& renderer, VkCommandPool command_pool, std::vector<Mesh> meshes, std::vector<Material> materials);
+		Model(const Renderer& renderer, UploadBatch& upload, std::vector<Mesh> meshes, std::vector<Material> materials);
 		~Model();
 
 		Model(const Model&) = default;
@@ -37,19 +47,48 @@ namespace SVL
 		Model& operator=(Model&&) = delete;
 
 		const VkDescriptorSet descriptor_set() { return vk_descriptor_set; }
-		const glm::mat4 ubo_model() { return model; }
-		const std::vector<Mesh> get_meshes() { return meshes; }
+		const glm::mat4 ubo_model() const { return model; }
+		const std::vector<Mesh>& get_meshes() const { return meshes; }
+		//vertices and indices of all meshes in the renderer geometry pool, mesh bases are relative to it
+		const GeometryPool::Range& geometry() const { return vk_geometry; }
 		std::vector<Material>& get_materials() { return materials; }
 		const bool can_render() { return _can_render; }
 
 		virtual const uint32_t objects_count() { return 1; }
 		virtual const uint32_t materials_count() { return materials.size(); }
-
-		virtual void create_descriptor_sets(VkDescriptorPool descriptor_pool, std::array<VkDescriptorSetLayout, 2> layouts, Texture* environment = nullptr);
-		virtual void render(VkCommandBuffer command_buffer, std::array<VkPipeline, 2> pipelines, VkPipelineLayout pipeline_layout);
-		virtual void update_uniform(glm::mat4 projection, glm::mat4 view, std::array<PointLight, 4> point_lights, glm::vec4 view_pos);
+		const uint32_t meshes_count() const { return meshes.size(); }
+
+		//layouts - object, material; allocates the sets on first call, later calls only rewrite them
+		//a null object layout skips the object set, for push constant transforms
+		//a null material layout skips the material sets, for bindless layers adding the materials to their BindlessMaterials
+		virtual void create_descriptor_sets(DescriptorAllocator& allocator, std::array<VkDescriptorSetLayout, 2> layouts, Texture* environment = nullptr);
+		virtual void destroy_descriptor_sets(DescriptorAllocator& allocator);
+		//frame selects the per frame uniform slice, bound through dynamic offsets; expects the scene set bound at set 0
+		//identity_instance - bound at binding 1 when the model is not instanced
+		//push_constants - transform and material index are pushed per draw instead of binding the object set
+		//materials without a set are bindless, their index is pushed instead of binding set 1
+		//visible_meshes - one flag per mesh, null draws every mesh
+		virtual void render(VkCommandBuffer command_buffer, std::array<VkPipeline, 2> pipelines, VkPipelineLayout pipeline_layout, uint32_t frame, VkBuffer identity_instance, bool push_constants = false, const uint8_t* visible_meshes = nullptr);
+		//same draws as render, added to list for sorting, view gives their depth
+		virtual void add_draws(DrawList& list, std::array<VkPipeline, 2> pipelines, uint32_t frame, VkBuffer identity_instance, const glm::mat4& view, bool push_constants = false, const uint8_t* visible_meshes = nullptr);
+		//writes the slice only if the transform changed since that slice was last written
+		virtual void update_uniform(uint32_t frame);
+		//same for the instance transforms
+		virtual void update_instances(uint32_t frame);
 
 		void set_ubo_model(glm::mat4 model);
+		//every mesh is drawn once with one instance per transform, applied after the model transform
+		//growing past the current capacity waits for the device
+		void set_instances(const std::vector<glm::mat4>& transforms);
+		void clear_instances();
+		const bool instanced() const { return vk_instances.enabled; }
+		const uint32_t instances_count() const { return vk_instances.enabled ? (uint32_t)vk_instances.transforms.size() : 1; }
+		const std::vector<glm::mat4>& instance_transforms() const { return vk_instances.transforms; }
+
+		//bumped on every transform change, layers re-record pushed transforms when it moves
+		const uint64_t transform_revision() const { return vk_revision; }
+		//bumped on changes recorded into command buffers regardless of the transform source, e.g. instance count
+		const uint64_t draw_revision() const { return vk_draw_revision; }
 
 		//virtual void handle_input(InputType, Input) {};
 		virtual void update() {};
@@ -64,23 +103,32 @@ namespace SVL
 		std::vector<Material> materials;
 
 		glm::mat4 model;
+		uint64_t vk_revision = 0;
+		uint64_t vk_draw_revision = 0;
 
 		struct
 		{
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+			UniformPool::Slot slot; //in the renderer uniform pool, one slice per frame in flight
 			VkDescriptorBufferInfo descriptor;
-			uint32_t size;
+			std::vector<bool> dirty; //per frame in flight
 		}vk_uniform_data;
 
+		GeometryPool::Range vk_geometry;
+
 		struct
 		{
-			uint64_t size = 0;
 			VkBuffer buffer = VK_NULL_HANDLE;
-			VkDeviceMemory memory = VK_NULL_HANDLE;
-		}vk_vertices, vk_indices;
+			Allocation allocation; //persistently mapped, capacity transforms per frame in flight
+			uint32_t capacity = 0;
+			bool enabled = false;
+			std::vector<glm::mat4> transforms;
+			std::vector<bool> dirty; //per frame in flight
+		}vk_instances;
 
 		VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE;
+
+		void create(UploadBatch& upload);
+		void create_uniform_buffer();
 	};
 }
 
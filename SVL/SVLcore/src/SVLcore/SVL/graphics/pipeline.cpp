@@ -1,8 +1,12 @@
 #include "pipeline.h"
 
 #include "renderer.h"
+#include "hash.h"
 #include <SVL/common/ErrorHandler.h>
 
+#include <algorithm>
+#include <string>
+
 void SVL::init::PipelineInit::update()
 {
 	vertex_input.vertexBindingDescriptionCount = vertex_bindings.size();
@@ -22,6 +26,56 @@ void SVL::init::PipelineInit::update()
 	dynamic_state.pDynamicStates = dynamic_states.data();
 }
 
+uint64_t SVL::init::PipelineInit::hash() const
+{
+	Hasher hasher;
+	hasher.add((uint64_t)stages.size());
+	for (const VkPipelineShaderStageCreateInfo& stage : stages)
+	{
+		hasher.add(stage.flags).add(stage.stage).add(stage.module).add(std::string(stage.pName ? stage.pName : ""));
+		const VkSpecializationInfo* specialization = stage.pSpecializationInfo;
+		hasher.add(specialization ? specialization->mapEntryCount : 0u);
+		if (specialization != nullptr)
+		{
+			for (uint32_t i = 0; i < specialization->mapEntryCount; i++)
+				hasher.add(specialization->pMapEntries[i].constantID).add(specialization->pMapEntries[i].offset).add((uint64_t)specialization->pMapEntries[i].size);
+			hasher.add((uint64_t)specialization->dataSize).add(specialization->pData, specialization->dataSize);
+		}
+	}
+
+	hasher.add(vertex_input.flags).add(vertex_bindings).add(vertex_attributes);
+	hasher.add(input_assembly.flags).add(input_assembly.topology).add(input_assembly.primitiveRestartEnable);
+	hasher.add(tessellation.flags).add(tessellation.patchControlPoints);
+
+	bool dynamic_viewport = std::find(dynamic_states.begin(), dynamic_states.end(), VK_DYNAMIC_STATE_VIEWPORT) != dynamic_states.end();
+	bool dynamic_scissor = std::find(dynamic_states.begin(), dynamic_states.end(), VK_DYNAMIC_STATE_SCISSOR) != dynamic_states.end();
+	hasher.add(viewport.flags);
+	if (dynamic_viewport) hasher.add((uint64_t)viewports.size());
+	else hasher.add(viewports);
+	if (dynamic_scissor) hasher.add((uint64_t)scissors.size());
+	else hasher.add(scissors);
+
+	hasher.add(rasterization.flags).add(rasterization.depthClampEnable).add(rasterization.rasterizerDiscardEnable)
+		.add(rasterization.polygonMode).add(rasterization.cullMode).add(rasterization.frontFace)
+		.add(rasterization.depthBiasEnable).add(rasterization.depthBiasConstantFactor).add(rasterization.depthBiasClamp)
+		.add(rasterization.depthBiasSlopeFactor).add(rasterization.lineWidth);
+
+	hasher.add(multisample.flags).add(multisample.rasterizationSamples).add(multisample.sampleShadingEnable)
+		.add(multisample.minSampleShading).add(multisample.alphaToCoverageEnable).add(multisample.alphaToOneEnable);
+	if (multisample.pSampleMask != nullptr)
+		hasher.add(multisample.pSampleMask, ((multisample.rasterizationSamples + 31) / 32) * sizeof(VkSampleMask));
+
+	hasher.add(depth_stencil.flags).add(depth_stencil.depthTestEnable).add(depth_stencil.depthWriteEnable)
+		.add(depth_stencil.depthCompareOp).add(depth_stencil.depthBoundsTestEnable).add(depth_stencil.stencilTestEnable)
+		.add(depth_stencil.front).add(depth_stencil.back).add(depth_stencil.minDepthBounds).add(depth_stencil.maxDepthBounds);
+
+	hasher.add(color_blend.flags).add(color_blend.logicOpEnable).add(color_blend.logicOp).add(color_blend_attachment_states);
+	hasher.add(color_blend.blendConstants, sizeof(color_blend.blendConstants));
+
+	hasher.add(dynamic_states);
+	return hasher.value();
+}
+
 SVL::Pipeline::Pipeline(const Renderer& r, VkRenderPass render_pass, VkPipelineLayout pipeline_layout, SVL::init::PipelineInit init)
 	: vk_renderer(r)
 {
@@ -45,10 +99,147 @@ SVL::Pipeline::Pipeline(const Renderer& r, VkRenderPass render_pass, VkPipelineL
 	pipeline_info.subpass = 0;
 	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 
-	ErrorCheck(vkCreateGraphicsPipelines(vk_renderer.device(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &vk_pipeline));
+	ErrorCheck(vkCreateGraphicsPipelines(vk_renderer.device(), vk_renderer.pipeline_cache(), 1, &pipeline_info, nullptr, &vk_pipeline));
 }
 
 SVL::Pipeline::~Pipeline()
 {
 	vkDestroyPipeline(vk_renderer.device(), vk_pipeline, nullptr);
+}
+
+SVL::PipelineRegistry::PipelineRegistry(const Renderer& renderer)
+	: vk_renderer(renderer)
+{
+}
+SVL::PipelineRegistry::~PipelineRegistry()
+{
+	prune();
+	if (!pipelines.empty())
+		Log("SVL: " + std::to_string(pipelines.size()) + " pipelines still referenced on registry destruction.");
+
+	for (auto& layout : pipeline_layouts)
+		vkDestroyPipelineLayout(vk_renderer.device(), layout.second, nullptr);
+	for (auto& sampler : samplers)
+		vkDestroySampler(vk_renderer.device(), sampler.second, nullptr);
+	for (auto& layout : descriptor_set_layouts)
+		vkDestroyDescriptorSetLayout(vk_renderer.device(), layout.second, nullptr);
+	for (auto& module : shader_modules)
+		vkDestroyShaderModule(vk_renderer.device(), module.second, nullptr);
+}
+
+std::shared_ptr<SVL::Pipeline> SVL::PipelineRegistry::pipeline(VkRenderPass render_pass, uint64_t render_pass_hash, VkPipelineLayout pipeline_layout, const SVL::init::PipelineInit& init)
+{
+	uint64_t key = Hasher().add(init.hash()).add(render_pass_hash).add(pipeline_layout).value();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = pipelines.find(key);
+	if (it != pipelines.end())
+	{
+		std::shared_ptr<Pipeline> pipeline = it->second.lock();
+		if (pipeline)
+			return pipeline;
+	}
+	else
+		prune(); //only on insertion, keeps lookups cheap
+
+	std::shared_ptr<Pipeline> pipeline = std::make_shared<Pipeline>(vk_renderer, render_pass, pipeline_layout, init);
+	pipelines[key] = pipeline;
+	return pipeline;
+}
+
+VkShaderModule SVL::PipelineRegistry::shader_module(const std::vector<unsigned char>& code)
+{
+	uint64_t key = Hasher().add(code).value();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = shader_modules.find(key);
+	if (it != shader_modules.end())
+		return it->second;
+
+	VkShaderModuleCreateInfo module_info{};
+	module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	module_info.codeSize = code.size();
+	module_info.pCode = (const uint32_t*)code.data();
+	VkShaderModule module;
+	ErrorCheck(vkCreateShaderModule(vk_renderer.device(), &module_info, nullptr, &module));
+	shader_modules[key] = module;
+	return module;
+}
+
+VkDescriptorSetLayout SVL::PipelineRegistry::descriptor_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+	Hasher hasher;
+	hasher.add((uint64_t)bindings.size());
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		hasher.add(binding.binding).add(binding.descriptorType).add(binding.descriptorCount).add(binding.stageFlags);
+		if (binding.pImmutableSamplers != nullptr)
+			hasher.add(binding.pImmutableSamplers, binding.descriptorCount * sizeof(VkSampler));
+	}
+	uint64_t key = hasher.value();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = descriptor_set_layouts.find(key);
+	if (it != descriptor_set_layouts.end())
+		return it->second;
+
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = bindings.size();
+	layout_info.pBindings = bindings.data();
+	VkDescriptorSetLayout layout;
+	ErrorCheck(vkCreateDescriptorSetLayout(vk_renderer.device(), &layout_info, nullptr, &layout));
+	descriptor_set_layouts[key] = layout;
+	return layout;
+}
+
+VkPipelineLayout SVL::PipelineRegistry::pipeline_layout(const std::vector<VkDescriptorSetLayout>& set_layouts, const std::vector<VkPushConstantRange>& push_constant_ranges)
+{
+	//set layouts come from this registry, equal definitions already share a handle
+	uint64_t key = Hasher().add(set_layouts).add(push_constant_ranges).value();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = pipeline_layouts.find(key);
+	if (it != pipeline_layouts.end())
+		return it->second;
+
+	VkPipelineLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_info.setLayoutCount = set_layouts.size();
+	layout_info.pSetLayouts = set_layouts.data();
+	layout_info.pushConstantRangeCount = push_constant_ranges.size();
+	layout_info.pPushConstantRanges = push_constant_ranges.data();
+	VkPipelineLayout layout;
+	ErrorCheck(vkCreatePipelineLayout(vk_renderer.device(), &layout_info, nullptr, &layout));
+	pipeline_layouts[key] = layout;
+	return layout;
+}
+
+void SVL::PipelineRegistry::prune()
+{
+	for (auto it = pipelines.begin(); it != pipelines.end();)
+	{
+		if (it->second.expired()) it = pipelines.erase(it);
+		else it++;
+	}
+}
+
+VkSampler SVL::PipelineRegistry::sampler(const VkSamplerCreateInfo& sampler_info)
+{
+	if (sampler_info.pNext != nullptr)
+		Log("SVL: sampler create info chain is not part of the registry key.");
+	uint64_t key = Hasher().add(sampler_info.flags).add(sampler_info.magFilter).add(sampler_info.minFilter).add(sampler_info.mipmapMode)
+		.add(sampler_info.addressModeU).add(sampler_info.addressModeV).add(sampler_info.addressModeW).add(sampler_info.mipLodBias)
+		.add(sampler_info.anisotropyEnable).add(sampler_info.maxAnisotropy).add(sampler_info.compareEnable).add(sampler_info.compareOp)
+		.add(sampler_info.minLod).add(sampler_info.maxLod).add(sampler_info.borderColor).add(sampler_info.unnormalizedCoordinates).value();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = samplers.find(key);
+	if (it != samplers.end())
+		return it->second;
+
+	VkSampler sampler;
+	ErrorCheck(vkCreateSampler(vk_renderer.device(), &sampler_info, nullptr, &sampler));
+	samplers[key] = sampler;
+	return sampler;
 }
\ No newline at end of file
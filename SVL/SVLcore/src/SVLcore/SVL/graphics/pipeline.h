@@ -4,6 +4,9 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace SVL
 {
@@ -90,6 +93,8 @@ namespace SVL
 			};
 
 			void update();
+			//covers everything the pipeline is built from except pNext chains, viewport and scissor values are skipped when dynamic
+			uint64_t hash() const;
 		};
 	};
 
@@ -115,6 +120,39 @@ namespace SVL
 		const class Renderer& vk_renderer;
 		VkPipeline vk_pipeline;
 	};
+
+	//renderer wide, hands out one object per distinct create state
+	//shader modules, layouts and samplers live as long as the registry, pipelines as long as someone holds them
+	class DLLDIR PipelineRegistry
+	{
+	public:
+		PipelineRegistry(const Renderer& renderer);
+		~PipelineRegistry();
+
+		PipelineRegistry(const PipelineRegistry&) = delete;
+		PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+		PipelineRegistry(PipelineRegistry&&) = delete;
+		PipelineRegistry& operator=(PipelineRegistry&&) = delete;
+
+		//render_pass_hash is RenderPass::compatibility_hash, the pipeline works with every compatible render pass
+		std::shared_ptr<Pipeline> pipeline(VkRenderPass render_pass, uint64_t render_pass_hash, VkPipelineLayout pipeline_layout, const SVL::init::PipelineInit& init);
+		VkShaderModule shader_module(const std::vector<unsigned char>& code);
+		VkDescriptorSetLayout descriptor_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		VkPipelineLayout pipeline_layout(const std::vector<VkDescriptorSetLayout>& set_layouts, const std::vector<VkPushConstantRange>& push_constant_ranges = {});
+		//keyed by the create info without its pNext chain, e.g. for immutable samplers of set layouts
+		VkSampler sampler(const VkSamplerCreateInfo& sampler_info);
+	private:
+		const class Renderer& vk_renderer;
+
+		std::unordered_map<uint64_t, std::weak_ptr<Pipeline>> pipelines;
+		std::unordered_map<uint64_t, VkShaderModule> shader_modules;
+		std::unordered_map<uint64_t, VkDescriptorSetLayout> descriptor_set_layouts;
+		std::unordered_map<uint64_t, VkPipelineLayout> pipeline_layouts;
+		std::unordered_map<uint64_t, VkSampler> samplers;
+		std::mutex mutex;
+
+		void prune(); //drops entries of released pipelines
+	};
 }
 
 #endif // !PIPELINE_H
\ No newline at end of file
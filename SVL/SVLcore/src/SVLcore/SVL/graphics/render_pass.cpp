@@ -1,8 +1,26 @@
 #include "render_pass.h"
 
 #include "renderer.h"
+#include "hash.h"
 #include <SVL/common/ErrorHandler.h>
 
+//attachment references are compared by the format and sample count they point at
+static void hash_references(SVL::Hasher& hasher, const std::vector<VkAttachmentDescription>& attachments, uint32_t count, const VkAttachmentReference* references)
+{
+	hasher.add(count);
+	for (uint32_t i = 0; references != nullptr && i < count; i++)
+	{
+		uint32_t attachment = references[i].attachment;
+		if (attachment == VK_ATTACHMENT_UNUSED || attachment >= attachments.size())
+		{
+			hasher.add(VK_ATTACHMENT_UNUSED);
+			continue;
+		}
+		hasher.add(attachments[attachment].format);
+		hasher.add(attachments[attachment].samples);
+	}
+}
+
 SVL::RenderPass::RenderPass(const Renderer& r, SVL::init::RenderPassInit init)
 	: RenderPass(r, init.attachments, init.subpasses, init.dependencies)
 {
@@ -21,6 +39,25 @@ SVL::RenderPass::RenderPass(const Renderer& r, std::vector<VkAttachmentDescripti
 	ci.pDependencies = dependencies.data();
 
 	ErrorCheck(vkCreateRenderPass(vk_renderer.device(), &ci, nullptr, &vk_render_pass));
+
+	Hasher hasher;
+	hasher.add((uint64_t)attachments.size());
+	for (const VkAttachmentDescription& attachment : attachments)
+		hasher.add(attachment.flags).add(attachment.format).add(attachment.samples);
+	hasher.add((uint64_t)subpasses.size());
+	for (const VkSubpassDescription& subpass : subpasses)
+	{
+		hasher.add(subpass.flags).add(subpass.pipelineBindPoint);
+		hash_references(hasher, attachments, subpass.inputAttachmentCount, subpass.pInputAttachments);
+		hash_references(hasher, attachments, subpass.colorAttachmentCount, subpass.pColorAttachments);
+		hash_references(hasher, attachments, subpass.pResolveAttachments ? subpass.colorAttachmentCount : 0, subpass.pResolveAttachments);
+		hash_references(hasher, attachments, subpass.pDepthStencilAttachment ? 1 : 0, subpass.pDepthStencilAttachment);
+		hasher.add(subpass.preserveAttachmentCount);
+		if (subpass.preserveAttachmentCount > 0)
+			hasher.add(subpass.pPreserveAttachments, subpass.preserveAttachmentCount * sizeof(uint32_t));
+	}
+	hasher.add(dependencies);
+	vk_compatibility_hash = hasher.value();
 }
 
 SVL::RenderPass::~RenderPass()
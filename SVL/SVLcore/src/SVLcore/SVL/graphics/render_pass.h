@@ -36,9 +36,12 @@ namespace SVL
 		{
 			return vk_render_pass;
 		}
+		//equal for render passes a pipeline may be used with interchangeably, layouts and load/store ops are ignored
+		const uint64_t compatibility_hash() const { return vk_compatibility_hash; }
 	private:
 		const class Renderer& vk_renderer;
 		VkRenderPass vk_render_pass;
+		uint64_t vk_compatibility_hash = 0;
 	};
 }
 
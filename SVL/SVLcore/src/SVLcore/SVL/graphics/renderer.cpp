@@ -1,7 +1,17 @@
 #include "renderer.h"
+#include "memory.h"
+#include "staging.h"
+#include "upload.h"
+#include "pipeline.h"
+#include "uniform.h"
+#include "geometry.h"
+#include "material.h"
 
 #include <SVL/common/ErrorHandler.h>
+#include <SVL/common/FileReplace.h>
 #include <sstream>
+#include <fstream>
+#include <cstring>
 
 VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
 	VkDebugUtilsMessageTypeFlagsEXT type,
@@ -80,7 +90,25 @@ bool SVL::Renderer::device_check_suitable(VkPhysicalDevice device)
 	vkGetPhysicalDeviceFeatures(device, &physical_device_features);
 	vkGetPhysicalDeviceFeatures2(device, &physical_device_features2);
 
-	return physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && physical_device_features.geometryShader && physical_device_features.samplerAnisotropy;
+	//any device type, pick_device prefers discrete gpus
+	return physical_device_properties.apiVersion >= VK_API_VERSION_1_1 && physical_device_features.samplerAnisotropy;
+}
+
+int SVL::Renderer::device_type_rank(VkPhysicalDeviceType type)
+{
+	switch (type)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return 4;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return 3;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return 2;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return 1;
+	default:
+		return 0;
+	}
 }
 
 std::vector<const char*> SVL::Renderer::get_renderer_layers()
@@ -119,18 +147,37 @@ void SVL::Renderer::destroy_debug_utils_messenger_ext(VkInstance instance, VkDeb
 		fnc(instance, debug_messenger, p_allocator);
 }
 
-SVL::Renderer::Renderer(std::string application_name, uint32_t application_version, bool debug)
-: application_name(application_name), application_version(application_version), debug(debug)
+SVL::Renderer::Renderer(std::string application_name, uint32_t application_version, bool debug, uint32_t frames_in_flight, std::string pipeline_cache_path)
+: application_name(application_name), application_version(application_version), debug(debug), vk_frames_in_flight(frames_in_flight), pipeline_cache_path(pipeline_cache_path)
 {
 	if(debug && !check_validation_layer_support())
 		Error("SVL ERROR: validation layers not available!");
+	if(frames_in_flight == 0)
+		Error("SVL ERROR: at least one frame in flight is required.");
 	
 	create_instance();
 	pick_device();
 	create_device();
+	create_pipeline_cache();
+
+	vk_allocator = new MemoryAllocator(*this);
+	vk_staging = new StagingRing(*this);
+	vk_uploads = new UploadQueue(*this);
+	vk_uniforms = new UniformPool(*this);
+	vk_geometry = new GeometryPool(*this);
+	vk_materials = new MaterialTable(*this, sizeof(Material::MaterialProperties));
+	vk_pipelines = new PipelineRegistry(*this);
 }
 SVL::Renderer::~Renderer()
 {
+	delete vk_pipelines;
+	delete vk_materials;
+	delete vk_geometry;
+	delete vk_uniforms;
+	delete vk_uploads;
+	delete vk_staging;
+	delete vk_allocator;
+	destroy_pipeline_cache();
 	vkDestroyDevice(vk_device, nullptr);
 	if(debug)
 		destroy_debug_utils_messenger_ext(vk_instance, debug_messenger, nullptr);
@@ -150,7 +197,8 @@ void SVL::Renderer::create_instance()
 
 	VkApplicationInfo application_info{};
 	application_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-	application_info.apiVersion = VK_MAKE_VERSION(1, 0, 3);
+	//1.1 for the features2 and properties2 queries, which descriptor indexing depends on
+	application_info.apiVersion = VK_API_VERSION_1_1;
 	application_info.engineVersion = ENGINE_VERSION;
 	application_info.pEngineName = ENGINE_NAME;
 	application_info.applicationVersion = application_version;
@@ -185,16 +233,24 @@ void SVL::Renderer::pick_device()
 	ErrorCheck(vkEnumeratePhysicalDevices(vk_instance, &physical_devices_count, nullptr));
 	std::vector<VkPhysicalDevice> physical_devices_list(physical_devices_count);
 	ErrorCheck(vkEnumeratePhysicalDevices(vk_instance, &physical_devices_count, physical_devices_list.data()));
+	//cpu implementations (lavapipe, swiftshader) are only picked when no gpu is suitable
+	int best_rank = -1;
 	for (const auto& device : physical_devices_list)
 	{
-		if (device_check_suitable(device))
+		if (!device_check_suitable(device))
+			continue;
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(device, &properties);
+		int rank = device_type_rank(properties.deviceType);
+		if (rank > best_rank)
 		{
+			best_rank = rank;
 			vk_physical_device = device;
-			break;
 		}
 	}
 	if (vk_physical_device == VK_NULL_HANDLE)
 		Error("Failed to find suitable GPU!");
+	vkGetPhysicalDeviceProperties(vk_physical_device, &vk_physical_device_properties);
 
 	//queue family
 	uint32_t queue_family_count = 0;
@@ -213,6 +269,33 @@ void SVL::Renderer::pick_device()
 	}
 	if (!found)
 		Error("SVL ERROR: Queue family supporting graphics not found.");
+
+	//uploads prefer a dedicated transfer family, then an async compute family
+	//families with coarse image transfer granularity cannot copy arbitrary regions
+	int transfer_family = -1, compute_family = -1;
+	for (uint32_t i = 0; i < queue_family_count; i++)
+	{
+		const VkQueueFamilyProperties& properties = family_properties_list[i];
+		const VkExtent3D& granularity = properties.minImageTransferGranularity;
+		if (properties.queueFlags & VK_QUEUE_GRAPHICS_BIT || granularity.width != 1 || granularity.height != 1 || granularity.depth != 1)
+			continue;
+		if (properties.queueFlags & VK_QUEUE_COMPUTE_BIT)
+		{
+			if (compute_family < 0)
+				compute_family = i;
+		}
+		else if (properties.queueFlags & VK_QUEUE_TRANSFER_BIT)
+		{
+			if (transfer_family < 0)
+				transfer_family = i;
+		}
+	}
+	if (transfer_family >= 0)
+		vk_transfer_family_index = transfer_family;
+	else if (compute_family >= 0)
+		vk_transfer_family_index = compute_family;
+	else
+		vk_transfer_family_index = vk_graphics_family_index;
 }
 
 void SVL::Renderer::create_device()
@@ -223,21 +306,79 @@ void SVL::Renderer::create_device()
 	device_features.textureCompressionBC = VK_TRUE;
 	device_features.fillModeNonSolid = VK_TRUE;
 	device_features.samplerAnisotropy = VK_TRUE;
+	//optional, gpu driven layers need them
+	VkPhysicalDeviceFeatures supported_features{};
+	vkGetPhysicalDeviceFeatures(vk_physical_device, &supported_features);
+	device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+	device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+	//optional, bindless materials need it
+	device_features.shaderSampledImageArrayDynamicIndexing = supported_features.shaderSampledImageArrayDynamicIndexing;
+	std::vector<VkDeviceQueueCreateInfo> device_queue_create_infos;
 	VkDeviceQueueCreateInfo device_queue_create_info{};
 	device_queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 	device_queue_create_info.queueFamilyIndex = vk_graphics_family_index;
 	device_queue_create_info.queueCount = 1;
 	device_queue_create_info.pQueuePriorities = queue_priorities;
+	device_queue_create_infos.push_back(device_queue_create_info);
+	if (vk_transfer_family_index != vk_graphics_family_index)
+	{
+		device_queue_create_info.queueFamilyIndex = vk_transfer_family_index;
+		device_queue_create_infos.push_back(device_queue_create_info);
+	}
 	VkDeviceCreateInfo device_create_info{};
 	device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	device_create_info.queueCreateInfoCount = 1;
-	device_create_info.pQueueCreateInfos = &device_queue_create_info;
+	device_create_info.queueCreateInfoCount = static_cast<uint32_t>(device_queue_create_infos.size());
+	device_create_info.pQueueCreateInfos = device_queue_create_infos.data();
 
 	auto renderer_layers = get_renderer_layers();
 	device_create_info.enabledLayerCount = static_cast<uint32_t>(renderer_layers.size());
 	device_create_info.ppEnabledLayerNames = renderer_layers.data();
 
 	auto device_extensions = get_device_extensions();
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extension_properties(extension_count);
+	vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &extension_count, extension_properties.data());
+	bool maintenance3_supported = false;
+	for (const VkExtensionProperties& extension : extension_properties)
+	{
+		if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+			draw_indirect_count_supported = true;
+		else if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+			descriptor_indexing_supported = true;
+		else if (strcmp(extension.extensionName, VK_KHR_MAINTENANCE3_EXTENSION_NAME) == 0)
+			maintenance3_supported = true;
+	}
+	if (draw_indirect_count_supported)
+		device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+	//only the features bindless materials use, the rest of the extension stays disabled
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features{};
+	descriptor_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (descriptor_indexing_supported && maintenance3_supported)
+	{
+		VkPhysicalDeviceFeatures2 supported_features2{};
+		supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supported_features2.pNext = &descriptor_indexing_features;
+		vkGetPhysicalDeviceFeatures2(vk_physical_device, &supported_features2);
+	}
+	descriptor_indexing_supported = descriptor_indexing_supported && maintenance3_supported
+		&& device_features.shaderSampledImageArrayDynamicIndexing
+		&& descriptor_indexing_features.runtimeDescriptorArray
+		&& descriptor_indexing_features.descriptorBindingPartiallyBound
+		&& descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind
+		&& descriptor_indexing_features.descriptorBindingUpdateUnusedWhilePending;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabled_descriptor_indexing{};
+	enabled_descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (descriptor_indexing_supported)
+	{
+		device_extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		enabled_descriptor_indexing.runtimeDescriptorArray = VK_TRUE;
+		enabled_descriptor_indexing.descriptorBindingPartiallyBound = VK_TRUE;
+		enabled_descriptor_indexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		enabled_descriptor_indexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	}
 	device_create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
 	device_create_info.ppEnabledExtensionNames = device_extensions.data();
 
@@ -249,13 +390,143 @@ void SVL::Renderer::create_device()
 	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 	features2.features = device_features;
 	//features2.pNext = &robustness2feature;
+	if (descriptor_indexing_supported)
+		features2.pNext = &enabled_descriptor_indexing;
 
 	device_create_info.pNext = &features2;
 	ErrorCheck(vkCreateDevice(vk_physical_device, &device_create_info, nullptr, &vk_device));
 	vkGetDeviceQueue(vk_device, vk_graphics_family_index, 0, &vk_queue);
+	vkGetDeviceQueue(vk_device, vk_transfer_family_index, 0, &vk_transfer_queue);
+
+	if (draw_indirect_count_supported)
+		vk_draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(vk_device, "vkCmdDrawIndexedIndirectCountKHR");
 }
 
 void SVL::Renderer::wait_for_device() const
 {
+	//waiting on the device needs every queue
+	std::lock(vk_queue_mutex, vk_transfer_queue_mutex);
+	std::lock_guard<std::mutex> queue_lock(vk_queue_mutex, std::adopt_lock);
+	std::lock_guard<std::mutex> transfer_queue_lock(vk_transfer_queue_mutex, std::adopt_lock);
 	ErrorCheck(vkDeviceWaitIdle(vk_device));
 }
+
+
+//file layout: header, then the data returned by vkGetPipelineCacheData
+//a cache written by another device or driver is discarded, drivers are not required to reject foreign data
+struct PipelineCacheHeader
+{
+	uint32_t magic;
+	uint32_t header_size;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint32_t driver_version;
+	uint8_t uuid[VK_UUID_SIZE];
+	uint64_t data_size;
+};
+static const uint32_t pipeline_cache_magic = 0x50434C53; //"SLCP"
+
+void SVL::Renderer::create_pipeline_cache()
+{
+	std::vector<char> data;
+	if (!pipeline_cache_path.empty())
+	{
+		std::ifstream file(pipeline_cache_path, std::ios::binary | std::ios::ate);
+		std::streamoff file_size = file.is_open() ? (std::streamoff)file.tellg() : 0;
+		file.seekg(0);
+		PipelineCacheHeader header{};
+		if (file.is_open() && file.read((char*)&header, sizeof(header)))
+		{
+			//the size comes from the file, check it before trusting it
+			uint64_t remaining = (uint64_t)(file_size - (std::streamoff)sizeof(header));
+			uint32_t vulkan_header[4] = {};
+			bool intact = header.magic == pipeline_cache_magic
+				&& header.header_size == sizeof(PipelineCacheHeader)
+				&& header.data_size <= remaining
+				&& header.data_size >= 16 + VK_UUID_SIZE;
+			if (intact)
+			{
+				data.resize((size_t)header.data_size);
+				intact = (bool)file.read(data.data(), data.size());
+			}
+			if (intact)
+			{
+				//vulkan header, its length field covers the length itself, version, vendor, device and uuid
+				memcpy(vulkan_header, data.data(), sizeof(vulkan_header));
+				intact = vulkan_header[0] >= 16 + VK_UUID_SIZE && vulkan_header[0] <= data.size()
+					&& vulkan_header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+			}
+
+			const VkPhysicalDeviceProperties& properties = vk_physical_device_properties;
+			if (!intact)
+			{
+				Log("SVL: pipeline cache " + pipeline_cache_path + " is truncated or corrupt, starting empty.");
+				data.clear();
+			}
+			//the vulkan header inside the data must agree as well
+			else if (header.vendor_id != properties.vendorID
+				|| header.device_id != properties.deviceID
+				|| header.driver_version != properties.driverVersion
+				|| memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0
+				|| vulkan_header[2] != properties.vendorID
+				|| vulkan_header[3] != properties.deviceID
+				|| memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+			{
+				Log("SVL: pipeline cache " + pipeline_cache_path + " does not match this device, starting empty.");
+				data.clear();
+			}
+		}
+	}
+
+	VkPipelineCacheCreateInfo cache_info{};
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cache_info.initialDataSize = data.size();
+	cache_info.pInitialData = data.empty() ? nullptr : data.data();
+	ErrorCheck(vkCreatePipelineCache(vk_device, &cache_info, nullptr, &vk_pipeline_cache));
+}
+
+void SVL::Renderer::destroy_pipeline_cache()
+{
+	save_pipeline_cache();
+	vkDestroyPipelineCache(vk_device, vk_pipeline_cache, nullptr);
+}
+
+void SVL::Renderer::save_pipeline_cache() const
+{
+	if (pipeline_cache_path.empty())
+		return;
+
+	size_t size = 0;
+	ErrorCheck(vkGetPipelineCacheData(vk_device, vk_pipeline_cache, &size, nullptr));
+	std::vector<char> data(size);
+	ErrorCheck(vkGetPipelineCacheData(vk_device, vk_pipeline_cache, &size, data.data()));
+
+	PipelineCacheHeader header{};
+	header.magic = pipeline_cache_magic;
+	header.header_size = sizeof(PipelineCacheHeader);
+	header.vendor_id = vk_physical_device_properties.vendorID;
+	header.device_id = vk_physical_device_properties.deviceID;
+	header.driver_version = vk_physical_device_properties.driverVersion;
+	memcpy(header.uuid, vk_physical_device_properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.data_size = size;
+
+	//write next to the target and move it over the old cache in one step, a crash leaves the old or the new cache
+	std::string temporary_path = pipeline_cache_path + ".tmp";
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			Log("SVL: cannot write pipeline cache " + temporary_path);
+			return;
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write(data.data(), size);
+		if (!file)
+		{
+			Log("SVL: cannot write pipeline cache " + temporary_path);
+			return;
+		}
+	}
+	if (!ReplaceFileAtomic(temporary_path, pipeline_cache_path))
+		Log("SVL: cannot replace pipeline cache " + pipeline_cache_path);
+}
\ No newline at end of file
@@ -6,13 +6,21 @@
 
 #include <vector>
 #include <string>
+#include <mutex>
 
 namespace SVL
 {
+	class MemoryAllocator;
+	class StagingRing;
+	class UploadQueue;
+	class PipelineRegistry;
+	class UniformPool;
+	class GeometryPool;
+	class MaterialTable;
 	class DLLDIR Renderer
 	{
 	public:
-		Renderer(std::string application_name, uint32_t application_version, bool debug = true);
+		Renderer(std::string application_name, uint32_t application_version, bool debug = true, uint32_t frames_in_flight = NUM_FRAMES_IN_FLIGHT, std::string pipeline_cache_path = PIPELINE_CACHE_FILE);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -22,32 +30,78 @@ namespace SVL
 
 		const VkInstance instance() const { return vk_instance; }
 		const VkPhysicalDevice physical_device() const { return vk_physical_device; }
+		const VkPhysicalDeviceProperties& properties() const { return vk_physical_device_properties; }
 		const uint32_t graphics_family_index() const { return vk_graphics_family_index; }
 		const VkDevice device() const { return vk_device; }
 		const VkQueue queue() const { return vk_queue; }
+		//equal to graphics queue/family when the device has no separate transfer capable family
+		const uint32_t transfer_family_index() const { return vk_transfer_family_index; }
+		const VkQueue transfer_queue() const { return vk_transfer_queue; }
+		//held around every vkQueueSubmit, vkQueuePresentKHR and vkQueueWaitIdle on queue, uploads submit from loader threads
+		//aliased queues share one mutex
+		std::mutex& queue_mutex(VkQueue queue) const { return queue == vk_transfer_queue && queue != vk_queue ? vk_transfer_queue_mutex : vk_queue_mutex; }
 		const std::string app_name() const { return application_name; }
+		//number of frames the cpu may record ahead of the gpu, per frame resources are sized by it
+		const uint32_t frames_in_flight() const { return vk_frames_in_flight; }
+		MemoryAllocator& allocator() const { return *vk_allocator; }
+		StagingRing& staging() const { return *vk_staging; }
+		UploadQueue& uploads() const { return *vk_uploads; }
+		UniformPool& uniforms() const { return *vk_uniforms; }
+		GeometryPool& geometry() const { return *vk_geometry; }
+		MaterialTable& materials() const { return *vk_materials; }
+		const VkPipelineCache pipeline_cache() const { return vk_pipeline_cache; }
+		PipelineRegistry& pipelines() const { return *vk_pipelines; }
+		//features enabled on the device, optional ones only when supported
+		const VkPhysicalDeviceFeatures& features() const { return device_features; }
+		//VK_KHR_draw_indirect_count, nullptr when the device does not support it
+		const PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count() const { return vk_draw_indexed_indirect_count; }
+		//VK_EXT_descriptor_indexing with runtime sized sampled image arrays, partially bound and written after bind
+		const bool descriptor_indexing() const { return descriptor_indexing_supported; }
 
 		void wait_for_device() const;
+		//also saved on destruction, empty path disables the disk cache
+		void save_pipeline_cache() const;
 	private:
 		const std::string application_name;
 		const uint32_t application_version;
 		const bool debug;
+		const uint32_t vk_frames_in_flight;
 
 		VkDebugUtilsMessengerEXT debug_messenger;
 		VkInstance vk_instance;
 
-		VkPhysicalDevice vk_physical_device;
+		VkPhysicalDevice vk_physical_device = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties vk_physical_device_properties{};
 		uint32_t vk_graphics_family_index;
+		uint32_t vk_transfer_family_index;
 
 		VkDevice vk_device;
 		VkQueue vk_queue;
+		VkQueue vk_transfer_queue;
+		mutable std::mutex vk_queue_mutex;
+		mutable std::mutex vk_transfer_queue_mutex;
+
+		MemoryAllocator* vk_allocator = nullptr;
+		StagingRing* vk_staging = nullptr;
+		UploadQueue* vk_uploads = nullptr;
+		UniformPool* vk_uniforms = nullptr;
+		GeometryPool* vk_geometry = nullptr;
+		MaterialTable* vk_materials = nullptr;
+
+		const std::string pipeline_cache_path;
+		VkPipelineCache vk_pipeline_cache = VK_NULL_HANDLE;
+		PipelineRegistry* vk_pipelines = nullptr;
 
 		VkPhysicalDeviceFeatures device_features{};
-		
+		bool draw_indirect_count_supported = false;
+		PFN_vkCmdDrawIndexedIndirectCountKHR vk_draw_indexed_indirect_count = nullptr;
+		bool descriptor_indexing_supported = false;
 
 		bool check_validation_layer_support();
 
 		virtual bool device_check_suitable(VkPhysicalDevice device);
+		//higher is preferred among suitable devices
+		static int device_type_rank(VkPhysicalDeviceType type);
 		virtual std::vector<const char*> get_renderer_layers();
 		virtual std::vector<const char*> get_instance_extensions();
 		virtual std::vector<const char*> get_device_extensions();
@@ -58,6 +112,9 @@ namespace SVL
 		void create_instance();
 		void pick_device();
 		void create_device();
+
+		void create_pipeline_cache();
+		void destroy_pipeline_cache();
 	};
 }
 
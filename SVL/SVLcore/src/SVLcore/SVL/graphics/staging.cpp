@@ -0,0 +1,181 @@
+#include "staging.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include "renderer.h"
+#include "tools.h"
+
+#include <cstring>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+SVL::StagingRing::StagingRing(const Renderer& renderer, VkDeviceSize size)
+	: vk_renderer(renderer), ring_size(size)
+{
+	SVLTools::create_buffer(vk_renderer, ring_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &vk_buffer, &vk_allocation);
+}
+
+SVL::StagingRing::~StagingRing()
+{
+	while (!in_flight.empty())
+		retire(true);
+	destroy_batch(current);
+
+	for (VkFence fence : free_fences)
+		vkDestroyFence(vk_renderer.device(), fence, nullptr);
+
+	SVLTools::destroy_buffer(vk_renderer, vk_buffer, vk_allocation);
+}
+
+SVL::StagingRing::Region SVL::StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Region region;
+	region.size = size;
+
+	//oversized payloads would stall the ring, they get a temporary buffer freed with the batch
+	if (size <= ring_size / 2)
+	{
+		retire(false);
+		VkDeviceSize offset;
+		bool found = try_allocate(size, alignment, offset);
+		while (!found && !in_flight.empty())
+		{
+			retire(true);
+			found = try_allocate(size, alignment, offset);
+		}
+		if (found)
+		{
+			head = offset + size;
+			current.ring = true;
+			current.end = head;
+
+			region.buffer = vk_buffer;
+			region.offset = offset;
+			region.data = static_cast<uint8_t*>(vk_allocation.mapped) + offset;
+			return region;
+		}
+	}
+
+	Temporary temporary;
+	SVLTools::create_buffer(vk_renderer, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &temporary.buffer, &temporary.allocation);
+	current.temporaries.push_back(temporary);
+
+	region.buffer = temporary.buffer;
+	region.offset = 0;
+	region.data = temporary.allocation.mapped;
+	return region;
+}
+
+SVL::StagingRing::Region SVL::StagingRing::upload(const void* source, VkDeviceSize size, VkDeviceSize alignment)
+{
+	Region region = allocate(size, alignment);
+	memcpy(region.data, source, (size_t)size);
+	return region;
+}
+
+void SVL::StagingRing::submit(VkQueue queue)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!current.ring && current.temporaries.empty())
+		return;
+
+	if (free_fences.empty())
+	{
+		VkFenceCreateInfo fence_info{};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence;
+		ErrorCheck(vkCreateFence(vk_renderer.device(), &fence_info, nullptr, &fence));
+		free_fences.push_back(fence);
+	}
+	current.fence = free_fences.back();
+	free_fences.pop_back();
+
+	//an empty submission signals its fence once all earlier work on the queue has completed
+	{
+		std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(queue));
+		ErrorCheck(vkQueueSubmit(queue, 0, nullptr, current.fence));
+	}
+
+	in_flight.push_back(std::move(current));
+	current = Batch();
+}
+
+bool SVL::StagingRing::empty() const
+{
+	if (current.ring)
+		return false;
+	for (const Batch& batch : in_flight)
+	{
+		if (batch.ring)
+			return false;
+	}
+	return true;
+}
+
+bool SVL::StagingRing::try_allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	if (empty())
+		head = tail = 0;
+
+	//free space is [head, ring_size) + [0, tail)
+	if (empty() || head > tail)
+	{
+		VkDeviceSize aligned = align_up(head, alignment);
+		if (aligned + size <= ring_size)
+		{
+			offset = aligned;
+			return true;
+		}
+		if (size <= tail)
+		{
+			offset = 0;
+			return true;
+		}
+		return false;
+	}
+	//free space is [head, tail)
+	if (head < tail)
+	{
+		VkDeviceSize aligned = align_up(head, alignment);
+		if (aligned + size <= tail)
+		{
+			offset = aligned;
+			return true;
+		}
+	}
+	return false;
+}
+
+void SVL::StagingRing::retire(bool wait)
+{
+	while (!in_flight.empty())
+	{
+		Batch& batch = in_flight.front();
+		if (wait)
+			ErrorCheck(vkWaitForFences(vk_renderer.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		else if (vkGetFenceStatus(vk_renderer.device(), batch.fence) != VK_SUCCESS)
+			break;
+
+		if (batch.ring)
+			tail = batch.end;
+		ErrorCheck(vkResetFences(vk_renderer.device(), 1, &batch.fence));
+		free_fences.push_back(batch.fence);
+		destroy_batch(batch);
+		in_flight.pop_front();
+
+		if (wait)
+			break;
+	}
+}
+
+void SVL::StagingRing::destroy_batch(Batch& batch)
+{
+	for (Temporary& temporary : batch.temporaries)
+		SVLTools::destroy_buffer(vk_renderer, temporary.buffer, temporary.allocation);
+	batch.temporaries.clear();
+}
@@ -0,0 +1,77 @@
+#ifndef STAGING_H
+#define STAGING_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+
+#include "memory.h"
+
+namespace SVL
+{
+	class Renderer;
+	class DLLDIR StagingRing
+	{
+	public:
+		struct Region
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			void* data = nullptr;
+		};
+
+		StagingRing(const Renderer& renderer, VkDeviceSize size = STAGING_RING_SIZE);
+		~StagingRing();
+
+		StagingRing(const StagingRing&) = delete;
+		StagingRing& operator=(const StagingRing&) = delete;
+		StagingRing(StagingRing&&) = delete;
+		StagingRing& operator=(StagingRing&&) = delete;
+
+		//regions stay valid until the batch they belong to is submitted and completed on the gpu
+		Region allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+		Region upload(const void* source, VkDeviceSize size, VkDeviceSize alignment = 16);
+		//closes the current batch, fenced behind all work already submitted to queue
+		void submit(VkQueue queue);
+
+		const VkDeviceSize size() const { return ring_size; }
+	private:
+		struct Temporary
+		{
+			VkBuffer buffer;
+			Allocation allocation;
+		};
+		struct Batch
+		{
+			VkFence fence = VK_NULL_HANDLE;
+			VkDeviceSize end = 0;
+			bool ring = false;
+			std::vector<Temporary> temporaries;
+		};
+
+		const class Renderer& vk_renderer;
+		const VkDeviceSize ring_size;
+
+		VkBuffer vk_buffer = VK_NULL_HANDLE;
+		Allocation vk_allocation;
+
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+
+		Batch current;
+		std::deque<Batch> in_flight;
+		std::vector<VkFence> free_fences;
+		std::mutex mutex;
+
+		bool empty() const;
+		bool try_allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		void retire(bool wait);
+		void destroy_batch(Batch& batch);
+	};
+}
+
+#endif // !STAGING_H
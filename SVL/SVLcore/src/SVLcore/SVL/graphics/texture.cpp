@@ -1,81 +1,75 @@
 #include "texture.h"
 #include "renderer.h"
 #include "tools.h"
+#include "upload.h"
+#include "pipeline.h"
 #include "../common/ErrorHandler.h"
 
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+namespace
+{
+	//bytes per 4 channel texel the cpu fallback can average, 0 for formats it can't
+	uint32_t box_filter_texel_size(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return 4;
+		case VK_FORMAT_R16G16B16A16_UNORM:
+			return 8;
+		default:
+			return 0;
+		}
+	}
+
+	//2x2 box filter, odd edges repeat the last texel; srgb is averaged without linearizing
+	template<typename T>
+	void box_filter(const T* source, VkExtent2D source_extent, T* destination, VkExtent2D extent)
+	{
+		for (uint32_t y = 0; y < extent.height; y++)
+		{
+			uint32_t y0 = std::min(y * 2, source_extent.height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, source_extent.height - 1);
+			for (uint32_t x = 0; x < extent.width; x++)
+			{
+				uint32_t x0 = std::min(x * 2, source_extent.width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, source_extent.width - 1);
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum = source[(y0 * source_extent.width + x0) * 4 + c] + source[(y0 * source_extent.width + x1) * 4 + c]
+						+ source[(y1 * source_extent.width + x0) * 4 + c] + source[(y1 * source_extent.width + x1) * 4 + c];
+					destination[(y * extent.width + x) * 4 + c] = (T)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
 
 SVL::Texture::Texture(const Renderer& renderer, ImageView&& image)
 	: vk_renderer(renderer), image(std::move(image))
 {
-	VkSamplerCreateInfo sampler_info{};
-	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	sampler_info.magFilter = VK_FILTER_LINEAR;
-	sampler_info.minFilter = VK_FILTER_LINEAR;
-	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.anisotropyEnable = VK_TRUE;
-	sampler_info.maxAnisotropy = 16.0f;
-	sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	sampler_info.unnormalizedCoordinates = VK_FALSE;
-	sampler_info.compareEnable = VK_FALSE;
-	sampler_info.compareOp = VK_COMPARE_OP_NEVER;
-	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	sampler_info.mipLodBias = 0.0f;
-	sampler_info.minLod = 0.0f;
-	sampler_info.maxLod = 1.0f;
-	ErrorCheck(vkCreateSampler(vk_renderer.device(), &sampler_info, nullptr, &image_sampler));
-	//descriptor
-	descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	descriptor.imageView = image.view;
-	descriptor.sampler = image_sampler;
+	create_sampler();
 }
 
 SVL::Texture::Texture(const Renderer& renderer, VkCommandPool command_pool, const void* image_data, size_t size, VkExtent2D extent, VkFormat format)
 	: vk_renderer(renderer), image(renderer)
 {
-	//buffer
-	VkBuffer buffer;
-	VkDeviceMemory buffer_memory;
-	SVLTools::create_buffer(vk_renderer.device(), vk_renderer.physical_device(), size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, &buffer_memory);
-	void* data;
-	ErrorCheck(vkMapMemory(vk_renderer.device(), buffer_memory, 0, size, 0, &data));
-	memcpy(data, image_data, size);
-	vkUnmapMemory(vk_renderer.device(), buffer_memory);
-	//image
-	image.create_2D_image({ extent.width, extent.height }, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 1, 1);
-	image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
-	//copy buffer to image
-	image.copy_buffer_to_image(command_pool, buffer, VK_IMAGE_ASPECT_COLOR_BIT);
-	image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
-	//destroy buffer
-	vkFreeMemory(vk_renderer.device(), buffer_memory, nullptr);
-	vkDestroyBuffer(vk_renderer.device(), buffer, nullptr);
-	//view
-	image.create_2D_image_view(VK_IMAGE_ASPECT_COLOR_BIT);
-	//sampler
-	VkSamplerCreateInfo sampler_info{};
-	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	sampler_info.magFilter = VK_FILTER_LINEAR;
-	sampler_info.minFilter = VK_FILTER_LINEAR;
-	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.anisotropyEnable = VK_TRUE;
-	sampler_info.maxAnisotropy = 16.0f;
-	sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	sampler_info.unnormalizedCoordinates = VK_FALSE;
-	sampler_info.compareEnable = VK_FALSE;
-	sampler_info.compareOp = VK_COMPARE_OP_NEVER;
-	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	sampler_info.mipLodBias = 0.0f;
-	sampler_info.minLod = 0.0f;
-	sampler_info.maxLod = 1.0f;
-	ErrorCheck(vkCreateSampler(vk_renderer.device(), &sampler_info, nullptr, &image_sampler));
-	//descriptor
-	descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	descriptor.imageView = image.view;
-	descriptor.sampler = image_sampler;
+	UploadBatch upload(vk_renderer);
+	create(upload, image_data, size, extent, format);
+	upload.submit();
+}
+
+SVL::Texture::Texture(const Renderer& renderer, UploadBatch& upload, const void* image_data, size_t size, VkExtent2D extent, VkFormat format)
+	: vk_renderer(renderer), image(renderer)
+{
+	create(upload, image_data, size, extent, format);
 }
 
 SVL::Texture::Texture(const Renderer& renderer, VkCommandPool command_pool, VkFormat format, VkImageCreateFlags img_flags)
@@ -98,17 +92,10 @@ SVL::Texture::Texture(const Renderer& renderer, VkCommandPool command_pool, VkFo
 
 	VkExtent2D extent{1,1};
 
-	//buffer
-	VkBuffer buffer;
-	VkDeviceMemory buffer_memory;
-	SVLTools::create_buffer(vk_renderer.device(), vk_renderer.physical_device(), size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, &buffer_memory);
-	void* data;
-	ErrorCheck(vkMapMemory(vk_renderer.device(), buffer_memory, 0, size, 0, &data));
-	memcpy(data, image_data, size);
-	vkUnmapMemory(vk_renderer.device(), buffer_memory);
+	UploadBatch upload(vk_renderer);
 	//image
 	image.create_2D_image({ extent.width, extent.height }, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 6, 1, img_flags);
-	image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	upload.transition_image_layout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
 	//copy buffer to image
 	std::vector<VkBufferImageCopy> bufferCopyRegions;
 	uint32_t offset = 0;
@@ -127,18 +114,100 @@ SVL::Texture::Texture(const Renderer& renderer, VkCommandPool command_pool, VkFo
 		bufferCopyRegions.push_back(bufferCopyRegion);
 		offset += 4;
 	}
-	image.copy_buffer_to_image(command_pool, buffer, bufferCopyRegions);
-	image.transition_image_layout(command_pool, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
-	//destroy buffer
-	vkFreeMemory(vk_renderer.device(), buffer_memory, nullptr);
-	vkDestroyBuffer(vk_renderer.device(), buffer, nullptr);
+	upload.copy_buffer_to_image(image_data, size, image, bufferCopyRegions);
+	upload.transition_image_layout(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	upload.submit();
 	delete image_data;
 	//view
 	if (img_flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
 		image.create_cube_image_view(VK_IMAGE_ASPECT_COLOR_BIT);
 	else
 		image.create_2D_image_view(VK_IMAGE_ASPECT_COLOR_BIT);
-	//sampler
+	create_sampler();
+}
+
+SVL::Texture::Texture(Texture&& tex)
+: image(std::move(tex.image)), image_sampler(std::move(tex.image_sampler)), descriptor(std::move(tex.descriptor)), vk_renderer(tex.vk_renderer)
+{
+	tex.del = false;
+}
+
+SVL::Texture::~Texture()
+{
+	if(del)
+	{
+		image.destroy();
+	}
+}
+
+void SVL::Texture::create(UploadBatch& upload, const void* image_data, size_t size, VkExtent2D extent, VkFormat format)
+{
+	//full mip chain, blitted on the gpu or box filtered here when the format can't be blitted
+	uint32_t mip_levels = 1;
+	for (uint32_t dimension = std::max(extent.width, extent.height); dimension > 1; dimension >>= 1)
+		mip_levels++;
+	bool blit = UploadBatch::can_generate_mipmaps(vk_renderer, format);
+	uint32_t texel_size = box_filter_texel_size(format);
+	if (!blit && texel_size == 0)
+	{
+		Log("SVL: texture format " + std::to_string(format) + " can't be blitted or filtered, texture has no mipmaps.");
+		mip_levels = 1;
+	}
+
+	//image
+	image.create_2D_image({ extent.width, extent.height }, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 1, mip_levels);
+	upload.transition_image_layout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	//copy buffer to image
+	if (blit && mip_levels > 1)
+	{
+		upload.copy_buffer_to_image(image_data, size, image, VK_IMAGE_ASPECT_COLOR_BIT);
+		upload.generate_mipmaps(image, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	else if (mip_levels > 1)
+	{
+		std::vector<VkBufferImageCopy> regions(mip_levels);
+		std::vector<VkExtent2D> extents(mip_levels);
+		VkDeviceSize chain_size = 0;
+		for (uint32_t level = 0; level < mip_levels; level++)
+		{
+			extents[level] = { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+			VkBufferImageCopy& region = regions[level];
+			region = {};
+			region.bufferOffset = chain_size;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { extents[level].width, extents[level].height, 1 };
+			chain_size += (VkDeviceSize)extents[level].width * extents[level].height * texel_size;
+		}
+
+		std::vector<uint8_t> chain((size_t)chain_size);
+		memcpy(chain.data(), image_data, std::min<size_t>(size, (size_t)regions[1].bufferOffset));
+		for (uint32_t level = 1; level < mip_levels; level++)
+		{
+			uint8_t* source = chain.data() + regions[level - 1].bufferOffset;
+			uint8_t* destination = chain.data() + regions[level].bufferOffset;
+			if (texel_size == 8)
+				box_filter(reinterpret_cast<uint16_t*>(source), extents[level - 1], reinterpret_cast<uint16_t*>(destination), extents[level]);
+			else
+				box_filter(source, extents[level - 1], destination, extents[level]);
+		}
+		upload.copy_buffer_to_image(chain.data(), chain_size, image, regions);
+		upload.transition_image_layout(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	else
+	{
+		upload.copy_buffer_to_image(image_data, size, image, VK_IMAGE_ASPECT_COLOR_BIT);
+		upload.transition_image_layout(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	//view
+	image.create_2D_image_view(VK_IMAGE_ASPECT_COLOR_BIT);
+	create_sampler();
+}
+
+VkSamplerCreateInfo SVL::Texture::sampler_info(uint32_t mip_levels)
+{
 	VkSamplerCreateInfo sampler_info{};
 	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	sampler_info.magFilter = VK_FILTER_LINEAR;
@@ -155,25 +224,16 @@ SVL::Texture::Texture(const Renderer& renderer, VkCommandPool command_pool, VkFo
 	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	sampler_info.mipLodBias = 0.0f;
 	sampler_info.minLod = 0.0f;
-	sampler_info.maxLod = 1.0f;
-	ErrorCheck(vkCreateSampler(vk_renderer.device(), &sampler_info, nullptr, &image_sampler));
+	sampler_info.maxLod = mip_levels == 0 ? VK_LOD_CLAMP_NONE : (float)mip_levels;
+	return sampler_info;
+}
+
+void SVL::Texture::create_sampler()
+{
+	//textures with equal sampler state share one sampler, scenes hold far more textures than drivers allow samplers
+	image_sampler = vk_renderer.pipelines().sampler(sampler_info(image.mip_levels));
 	//descriptor
 	descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	descriptor.imageView = image.view;
 	descriptor.sampler = image_sampler;
 }
-
-SVL::Texture::Texture(Texture&& tex)
-: image(std::move(tex.image)), image_sampler(std::move(tex.image_sampler)), descriptor(std::move(tex.descriptor)), vk_renderer(tex.vk_renderer)
-{
-	tex.del = false;
-}
-
-SVL::Texture::~Texture()
-{
-	if(del)
-	{
-		vkDestroySampler(vk_renderer.device(), image_sampler, nullptr);
-		image.destroy();
-	}
-}
@@ -8,11 +8,13 @@
 namespace SVL
 {
 	class Renderer;
+	class UploadBatch;
 	class DLLDIR Texture final
 	{
 	public:
 		Texture(const Renderer&, ImageView&& image);
 		Texture(const Renderer& renderer, VkCommandPool command_pool, const void* image_data, size_t size, VkExtent2D extent, VkFormat format);
+		Texture(const Renderer& renderer, UploadBatch& upload, const void* image_data, size_t size, VkExtent2D extent, VkFormat format);
 		Texture(const Renderer& renderer, VkCommandPool command_pool, VkFormat format, VkImageCreateFlags img_flags = 0);//empty texture
 		~Texture();
 
@@ -21,12 +23,18 @@ namespace SVL
 		Texture(Texture&&);
 		Texture& operator=(Texture&&) = delete;
 
+		//linear, repeat, 16x anisotropic; mip_levels 0 clamps no lod, for samplers shared by textures of any mip count
+		static VkSamplerCreateInfo sampler_info(uint32_t mip_levels);
+
 		ImageView image;
-		VkSampler image_sampler = VK_NULL_HANDLE;
+		VkSampler image_sampler = VK_NULL_HANDLE; //shared through the renderer pipeline registry
 		VkDescriptorImageInfo descriptor{};
 	private:
 		const class Renderer& vk_renderer;
 		bool del = true;
+
+		void create(UploadBatch& upload, const void* image_data, size_t size, VkExtent2D extent, VkFormat format);
+		void create_sampler();
 	};
 }
 #endif
@@ -0,0 +1,61 @@
+#include "thread_pool.h"
+
+SVL::ThreadPool::ThreadPool(uint32_t thread_count)
+{
+	if (thread_count == 0)
+		thread_count = 1;
+	for (uint32_t i = 0; i < thread_count; i++)
+		workers.emplace_back(&ThreadPool::work, this);
+}
+
+SVL::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	task_available.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void SVL::ThreadPool::push(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	task_available.notify_one();
+}
+
+void SVL::ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	tasks_done.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+void SVL::ThreadPool::work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			task_available.wait(lock, [this] { return stop || !tasks.empty(); });
+			if (stop && tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			running++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running--;
+			if (tasks.empty() && running == 0)
+				tasks_done.notify_all();
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <SVL/definitions.h>
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace SVL
+{
+	class DLLDIR ThreadPool
+	{
+	public:
+		ThreadPool(uint32_t thread_count = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+
+		void push(std::function<void()> task);
+		//blocks until every pushed task has finished
+		void wait();
+
+		const uint32_t size() const { return (uint32_t)workers.size(); }
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> tasks;
+		uint32_t running = 0;
+		bool stop = false;
+
+		std::mutex mutex;
+		std::condition_variable task_available;
+		std::condition_variable tasks_done;
+
+		void work();
+	};
+}
+
+#endif // !THREAD_POOL_H
@@ -1,6 +1,8 @@
 #include "tools.h"
 #include "../common/ErrorHandler.h"
 #include "vertex.h"
+#include "renderer.h"
+#include "upload.h"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
@@ -11,9 +13,12 @@ SVL::init::PipelineInit SVLTools::create_predefined_pipeline(VkExtent2D extent,
 	SVL::init::PipelineInit init;
 
 	init.vertex_bindings.push_back(SVL::Vertex3D::binding_descriptor());
+	init.vertex_bindings.push_back(SVL::Instance3D::binding_descriptor());
 
 	auto vertex_att = SVL::Vertex3D::attribute_descriptor();
 	init.vertex_attributes.insert(init.vertex_attributes.end(), vertex_att.begin(), vertex_att.end());
+	auto instance_att = SVL::Instance3D::attribute_descriptor();
+	init.vertex_attributes.insert(init.vertex_attributes.end(), instance_att.begin(), instance_att.end());
 
 	VkPipelineShaderStageCreateInfo vertexShaderStageInfo = {};
 	vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -174,6 +179,30 @@ void SVLTools::create_buffer(VkDevice device, VkPhysicalDevice physical_device,
 	ErrorCheck(vkAllocateMemory(device, &memory_allocate_info, nullptr, buffer_memory));
 	ErrorCheck(vkBindBufferMemory(device, *buffer, *buffer_memory, 0));
 }
+void SVLTools::create_buffer_and_memory(const SVL::Renderer& renderer, SVL::UploadBatch& batch, VkDeviceSize buffer_size, const void* source, VkBufferUsageFlags usage, VkBuffer& buffer, SVL::Allocation& allocation)
+{
+	create_buffer(renderer, buffer_size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, &allocation);
+	batch.copy_buffer(source, buffer_size, buffer);
+}
+void SVLTools::create_buffer(const SVL::Renderer& renderer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, SVL::Allocation* allocation)
+{
+	VkBufferCreateInfo buffer_info = {};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = size;
+	buffer_info.usage = usage;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	ErrorCheck(vkCreateBuffer(renderer.device(), &buffer_info, nullptr, buffer));
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(renderer.device(), *buffer, &memory_requirements);
+	*allocation = renderer.allocator().allocate(memory_requirements, properties, true);
+	renderer.allocator().bind_buffer(*buffer, *allocation);
+}
+void SVLTools::destroy_buffer(const SVL::Renderer& renderer, VkBuffer& buffer, SVL::Allocation& allocation)
+{
+	vkDestroyBuffer(renderer.device(), buffer, nullptr);
+	buffer = VK_NULL_HANDLE;
+	renderer.allocator().free(allocation);
+}
 void SVLTools::copy_buffer(VkDevice device, VkQueue queue, VkCommandPool command_pool, VkBuffer source_buffer, VkBuffer destination_buffer, VkDeviceSize size)
 {
 	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
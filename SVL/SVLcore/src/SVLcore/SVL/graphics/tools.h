@@ -7,9 +7,12 @@
 #include <string>
 
 #include "pipeline.h"
+#include "memory.h"
 
 typedef unsigned char byte;
 
+namespace SVL { class Renderer; class UploadBatch; }
+
 namespace SVLTools
 {
 	enum PipelineType
@@ -28,6 +31,10 @@ namespace SVLTools
 
 	DLLDIR void create_buffer_and_memory(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, VkCommandPool command_pool, VkDeviceSize buffer_size, const void * source, VkBufferUsageFlags staging_usage, VkMemoryPropertyFlags staging_properties, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer & buffer, VkDeviceMemory & buffer_memory);
 	DLLDIR void create_buffer(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, VkDeviceMemory* buffer_memory);
+	//sub-allocated through the renderer's allocator, the copy is recorded into batch
+	DLLDIR void create_buffer_and_memory(const ::SVL::Renderer& renderer, ::SVL::UploadBatch& batch, VkDeviceSize buffer_size, const void* source, VkBufferUsageFlags usage, VkBuffer& buffer, ::SVL::Allocation& allocation);
+	DLLDIR void create_buffer(const ::SVL::Renderer& renderer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, ::SVL::Allocation* allocation);
+	DLLDIR void destroy_buffer(const ::SVL::Renderer& renderer, VkBuffer& buffer, ::SVL::Allocation& allocation);
 	DLLDIR void copy_buffer(VkDevice device, VkQueue queue, VkCommandPool command_pool, VkBuffer source_buffer, VkBuffer destination_buffer, VkDeviceSize size);
 
 	DLLDIR void begin_single_time_commands(VkDevice device, VkCommandPool command_pool, VkCommandBuffer & command_buffer);
@@ -0,0 +1,68 @@
+#include "uniform.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include "renderer.h"
+#include "tools.h"
+
+SVL::UniformPool::UniformPool(const Renderer& renderer, uint32_t slots_per_page)
+	: vk_renderer(renderer), slots_per_page(slots_per_page)
+{
+}
+
+SVL::UniformPool::~UniformPool()
+{
+	for (Page& page : pages)
+		SVLTools::destroy_buffer(vk_renderer, page.buffer, page.allocation);
+}
+
+SVL::UniformPool::Slot SVL::UniformPool::allocate(VkDeviceSize size)
+{
+	VkDeviceSize alignment = vk_renderer.properties().limits.minUniformBufferOffsetAlignment;
+	VkDeviceSize stride = (size + alignment - 1) / alignment * alignment;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint32_t page_index = UINT32_MAX;
+	for (uint32_t i = 0; i < pages.size(); i++)
+	{
+		if (pages[i].stride == stride && !pages[i].free_slots.empty())
+		{
+			page_index = i;
+			break;
+		}
+	}
+	if (page_index == UINT32_MAX)
+	{
+		Page page;
+		page.stride = stride;
+		SVLTools::create_buffer(vk_renderer, stride * slots_per_page * vk_renderer.frames_in_flight(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &page.buffer, &page.allocation);
+		//popped from the back, hand out low slots first
+		for (uint32_t i = slots_per_page; i > 0; i--)
+			page.free_slots.push_back(i - 1);
+		pages.push_back(page);
+		page_index = pages.size() - 1;
+	}
+
+	Page& page = pages[page_index];
+	Slot slot;
+	slot.index = page.free_slots.back();
+	page.free_slots.pop_back();
+
+	slot.buffer = page.buffer;
+	slot.size = size;
+	slot.page = page_index;
+	slot.offset = (uint32_t)(slot.index * stride);
+	slot.frame_stride = (uint32_t)(stride * slots_per_page);
+	slot.mapped = static_cast<uint8_t*>(page.allocation.mapped) + slot.offset;
+	return slot;
+}
+
+void SVL::UniformPool::free(Slot& slot)
+{
+	if (slot.page == UINT32_MAX)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	pages[slot.page].free_slots.push_back(slot.index);
+	slot = Slot();
+}
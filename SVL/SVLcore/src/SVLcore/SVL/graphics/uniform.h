@@ -0,0 +1,63 @@
+#ifndef UNIFORM_H
+#define UNIFORM_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+
+#include "memory.h"
+
+namespace SVL
+{
+	class Renderer;
+	//per object uniform slices packed into shared, persistently mapped buffers
+	//a page holds slots_per_page slots for every frame in flight, frame slices are contiguous
+	class DLLDIR UniformPool
+	{
+	public:
+		struct Slot
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t offset = 0; //of frame 0
+			uint32_t frame_stride = 0;
+			uint8_t* mapped = nullptr; //of frame 0
+			uint32_t page = UINT32_MAX;
+			uint32_t index = 0;
+
+			//bind with offset 0 and range size, the slot is selected through the dynamic offset
+			const uint32_t dynamic_offset(uint32_t frame) const { return offset + frame * frame_stride; }
+			void* data(uint32_t frame) const { return mapped + frame * frame_stride; }
+		};
+
+		UniformPool(const Renderer& renderer, uint32_t slots_per_page = UNIFORM_POOL_PAGE_SLOTS);
+		~UniformPool();
+
+		UniformPool(const UniformPool&) = delete;
+		UniformPool& operator=(const UniformPool&) = delete;
+		UniformPool(UniformPool&&) = delete;
+		UniformPool& operator=(UniformPool&&) = delete;
+
+		//size is rounded up to minUniformBufferOffsetAlignment, slots of equal stride share pages
+		Slot allocate(VkDeviceSize size);
+		//the slot must no longer be used by frames in flight
+		void free(Slot& slot);
+	private:
+		struct Page
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			Allocation allocation;
+			VkDeviceSize stride = 0;
+			std::vector<uint32_t> free_slots;
+		};
+
+		const class Renderer& vk_renderer;
+		const uint32_t slots_per_page;
+		std::vector<Page> pages;
+		std::mutex mutex;
+	};
+}
+
+#endif // !UNIFORM_H
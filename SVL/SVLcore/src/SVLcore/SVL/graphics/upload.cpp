@@ -0,0 +1,451 @@
+#include "upload.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include "renderer.h"
+#include "staging.h"
+#include "image.h"
+
+SVL::UploadBatch::UploadBatch(const Renderer& renderer)
+	: vk_renderer(renderer)
+{
+	vk_recorder = vk_renderer.uploads().begin(vk_transfer_command_buffer, vk_graphics_command_buffer);
+}
+
+SVL::UploadBatch::~UploadBatch()
+{
+	if (!submitted)
+		submit();
+}
+
+void SVL::UploadBatch::copy_buffer(const void* source, VkDeviceSize size, VkBuffer destination, VkDeviceSize destination_offset)
+{
+	StagingRing::Region staging = vk_renderer.staging().upload(source, size);
+
+	VkBufferCopy copy_region = {};
+	copy_region.srcOffset = staging.offset;
+	copy_region.dstOffset = destination_offset;
+	copy_region.size = size;
+	vkCmdCopyBuffer(vk_transfer_command_buffer, staging.buffer, destination, 1, &copy_region);
+	recorded = true;
+
+	if (vk_graphics_command_buffer == VK_NULL_HANDLE)
+		return;
+
+	//queue family ownership transfer, release on the transfer queue and acquire on the graphics queue
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = vk_renderer.transfer_family_index();
+	barrier.dstQueueFamilyIndex = vk_renderer.graphics_family_index();
+	barrier.buffer = destination;
+	barrier.offset = destination_offset;
+	barrier.size = size;
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(vk_transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(vk_graphics_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void SVL::UploadBatch::copy_buffer_to_image(const void* source, VkDeviceSize size, Image& image, std::vector<VkBufferImageCopy> regions)
+{
+	StagingRing::Region staging = vk_renderer.staging().upload(source, size);
+
+	for (VkBufferImageCopy& region : regions)
+		region.bufferOffset += staging.offset;
+	vkCmdCopyBufferToImage(vk_transfer_command_buffer, staging.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+	recorded = true;
+}
+
+void SVL::UploadBatch::copy_buffer_to_image(const void* source, VkDeviceSize size, Image& image, VkImageAspectFlags aspect)
+{
+	VkBufferImageCopy region{};
+	region.imageSubresource.aspectMask = aspect;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = image.array_layers;
+	region.imageExtent.width = image.extent.width;
+	region.imageExtent.height = image.extent.height;
+	region.imageExtent.depth = 1;
+
+	copy_buffer_to_image(source, size, image, std::vector<VkBufferImageCopy>{ region });
+}
+
+void SVL::UploadBatch::transition_image_layout(Image& image, VkImageLayout new_layout, VkImageAspectFlags aspect)
+{
+	recorded = true;
+	if (vk_graphics_command_buffer == VK_NULL_HANDLE || new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL || new_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+	{
+		image.transition_image_layout(vk_transfer_command_buffer, new_layout, aspect);
+		return;
+	}
+
+	//leaving the transfer queue, the layout transition happens as part of the ownership transfer
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = image.layout;
+	barrier.newLayout = new_layout;
+	barrier.srcQueueFamilyIndex = vk_renderer.transfer_family_index();
+	barrier.dstQueueFamilyIndex = vk_renderer.graphics_family_index();
+	barrier.image = image.image;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = image.mip_levels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = image.array_layers;
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(vk_transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(vk_graphics_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	image.layout = new_layout;
+}
+
+void SVL::UploadBatch::generate_mipmaps(Image& image, VkImageAspectFlags aspect)
+{
+	recorded = true;
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image.image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = image.array_layers;
+
+	//blits need a graphics queue, the copied image changes owner first and keeps its layout
+	VkCommandBuffer command_buffer = vk_transfer_command_buffer;
+	if (vk_graphics_command_buffer != VK_NULL_HANDLE)
+	{
+		command_buffer = vk_graphics_command_buffer;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = vk_renderer.transfer_family_index();
+		barrier.dstQueueFamilyIndex = vk_renderer.graphics_family_index();
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = image.mip_levels;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(vk_transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(vk_graphics_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	}
+
+	barrier.subresourceRange.levelCount = 1;
+	int32_t width = (int32_t)image.extent.width;
+	int32_t height = (int32_t)image.extent.height;
+	for (uint32_t level = 1; level < image.mip_levels; level++)
+	{
+		//the previous level is complete, read it from here on
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageBlit blit{};
+		blit.srcSubresource.aspectMask = aspect;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = image.array_layers;
+		blit.srcOffsets[1] = { width, height, 1 };
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		blit.dstSubresource = blit.srcSubresource;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstOffsets[1] = { width, height, 1 };
+		vkCmdBlitImage(command_buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+	}
+
+	//every level but the last was a blit source
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = image.mip_levels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	VkImageMemoryBarrier last_barrier = barrier;
+	last_barrier.subresourceRange.baseMipLevel = image.mip_levels - 1;
+	last_barrier.subresourceRange.levelCount = 1;
+	last_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	last_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	VkImageMemoryBarrier barriers[] = { barrier, last_barrier };
+	uint32_t first = image.mip_levels > 1 ? 0 : 1;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2 - first, barriers + first);
+
+	image.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+bool SVL::UploadBatch::can_generate_mipmaps(const Renderer& renderer, VkFormat format)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(renderer.physical_device(), format, &properties);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+uint64_t SVL::UploadBatch::submit()
+{
+	submitted = true;
+	if (!recorded)
+	{
+		vk_renderer.uploads().release(vk_recorder);
+		return 0;
+	}
+
+	if (vk_graphics_command_buffer == VK_NULL_HANDLE)
+	{
+		//make the copied data visible to everything submitted to the queue after this batch
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(vk_transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	return vk_renderer.uploads().submit(vk_recorder);
+}
+
+
+
+SVL::UploadQueue::UploadQueue(const Renderer& renderer)
+	: vk_renderer(renderer), separate_transfer_family(renderer.transfer_family_index() != renderer.graphics_family_index())
+{
+}
+
+SVL::UploadQueue::~UploadQueue()
+{
+	wait_idle();
+
+	for (VkSemaphore semaphore : free_semaphores)
+		vkDestroySemaphore(vk_renderer.device(), semaphore, nullptr);
+	for (VkFence fence : free_fences)
+		vkDestroyFence(vk_renderer.device(), fence, nullptr);
+	for (const Recorder& recorder : recorders)
+	{
+		vkDestroyCommandPool(vk_renderer.device(), recorder.transfer_command_pool, nullptr);
+		if (recorder.graphics_command_pool != VK_NULL_HANDLE)
+			vkDestroyCommandPool(vk_renderer.device(), recorder.graphics_command_pool, nullptr);
+	}
+}
+
+bool SVL::UploadQueue::is_complete(uint64_t token)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	retire(false);
+	return token <= completed_token;
+}
+
+void SVL::UploadQueue::wait(uint64_t token)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	retire(false);
+	while (token > completed_token && !pending.empty())
+		retire(true);
+}
+
+void SVL::UploadQueue::wait_idle()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	while (!pending.empty())
+		retire(true);
+}
+
+uint32_t SVL::UploadQueue::begin(VkCommandBuffer& transfer_command_buffer, VkCommandBuffer& graphics_command_buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	retire(false);
+
+	uint32_t index;
+	if (free_recorders.empty())
+	{
+		index = create_recorder();
+	}
+	else
+	{
+		index = free_recorders.back();
+		free_recorders.pop_back();
+	}
+
+	//recording happens outside the mutex, only the batch owning the recorder touches its pools until it is released or retired
+	Recorder& recorder = recorders[index];
+	transfer_command_buffer = begin_command_buffer(recorder.transfer_command_pool, recorder.transfer_command_buffer);
+	graphics_command_buffer = VK_NULL_HANDLE;
+	if (recorder.graphics_command_pool != VK_NULL_HANDLE)
+		graphics_command_buffer = begin_command_buffer(recorder.graphics_command_pool, recorder.graphics_command_buffer);
+	open_batches++;
+	return index;
+}
+
+uint64_t SVL::UploadQueue::submit(uint32_t recorder)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	VkCommandBuffer transfer_command_buffer = recorders[recorder].transfer_command_buffer;
+	VkCommandBuffer graphics_command_buffer = recorders[recorder].graphics_command_buffer;
+	ErrorCheck(vkEndCommandBuffer(transfer_command_buffer));
+
+	Submission submission;
+	submission.recorder = recorder;
+	submission.semaphore = VK_NULL_HANDLE;
+	submission.token = next_token++;
+	if (free_fences.empty())
+	{
+		VkFenceCreateInfo fence_info{};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		ErrorCheck(vkCreateFence(vk_renderer.device(), &fence_info, nullptr, &submission.fence));
+	}
+	else
+	{
+		submission.fence = free_fences.back();
+		free_fences.pop_back();
+	}
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &transfer_command_buffer;
+	if (graphics_command_buffer == VK_NULL_HANDLE)
+	{
+		std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.transfer_queue()));
+		ErrorCheck(vkQueueSubmit(vk_renderer.transfer_queue(), 1, &submit_info, submission.fence));
+	}
+	else
+	{
+		ErrorCheck(vkEndCommandBuffer(graphics_command_buffer));
+		if (free_semaphores.empty())
+		{
+			VkSemaphoreCreateInfo semaphore_info{};
+			semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			ErrorCheck(vkCreateSemaphore(vk_renderer.device(), &semaphore_info, nullptr, &submission.semaphore));
+		}
+		else
+		{
+			submission.semaphore = free_semaphores.back();
+			free_semaphores.pop_back();
+		}
+
+		//transfer queue copies and releases, graphics queue acquires once the copies are done
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &submission.semaphore;
+		{
+			std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.transfer_queue()));
+			ErrorCheck(vkQueueSubmit(vk_renderer.transfer_queue(), 1, &submit_info, VK_NULL_HANDLE));
+		}
+
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		VkSubmitInfo acquire_info = {};
+		acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquire_info.waitSemaphoreCount = 1;
+		acquire_info.pWaitSemaphores = &submission.semaphore;
+		acquire_info.pWaitDstStageMask = &wait_stage;
+		acquire_info.commandBufferCount = 1;
+		acquire_info.pCommandBuffers = &graphics_command_buffer;
+		std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.queue()));
+		ErrorCheck(vkQueueSubmit(vk_renderer.queue(), 1, &acquire_info, submission.fence));
+	}
+	close_batch();
+
+	pending.push_back(submission);
+	return submission.token;
+}
+
+void SVL::UploadQueue::release(uint32_t recorder)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	ErrorCheck(vkEndCommandBuffer(recorders[recorder].transfer_command_buffer));
+	if (recorders[recorder].graphics_command_buffer != VK_NULL_HANDLE)
+		ErrorCheck(vkEndCommandBuffer(recorders[recorder].graphics_command_buffer));
+	reset_recorder(recorder);
+	close_batch();
+}
+
+void SVL::UploadQueue::close_batch()
+{
+	//staging regions of a batch that is still recording must not be fenced by an earlier submit
+	//the fence goes on the graphics queue, which waits for the transfer queue through the batch semaphores
+	open_batches--;
+	if (open_batches == 0)
+		vk_renderer.staging().submit(vk_renderer.queue());
+}
+
+void SVL::UploadQueue::retire(bool wait)
+{
+	while (!pending.empty())
+	{
+		Submission& submission = pending.front();
+		if (wait)
+			ErrorCheck(vkWaitForFences(vk_renderer.device(), 1, &submission.fence, VK_TRUE, UINT64_MAX));
+		else if (vkGetFenceStatus(vk_renderer.device(), submission.fence) != VK_SUCCESS)
+			break;
+
+		ErrorCheck(vkResetFences(vk_renderer.device(), 1, &submission.fence));
+		free_fences.push_back(submission.fence);
+		if (submission.semaphore != VK_NULL_HANDLE)
+			free_semaphores.push_back(submission.semaphore);
+		reset_recorder(submission.recorder);
+		completed_token = submission.token;
+		pending.pop_front();
+
+		if (wait)
+			break;
+	}
+}
+
+uint32_t SVL::UploadQueue::create_recorder()
+{
+	VkCommandPoolCreateInfo command_pool_info{};
+	command_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	command_pool_info.queueFamilyIndex = vk_renderer.transfer_family_index();
+	command_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	Recorder recorder;
+	ErrorCheck(vkCreateCommandPool(vk_renderer.device(), &command_pool_info, nullptr, &recorder.transfer_command_pool));
+	if (separate_transfer_family)
+	{
+		command_pool_info.queueFamilyIndex = vk_renderer.graphics_family_index();
+		ErrorCheck(vkCreateCommandPool(vk_renderer.device(), &command_pool_info, nullptr, &recorder.graphics_command_pool));
+	}
+	recorders.push_back(recorder);
+	return (uint32_t)recorders.size() - 1;
+}
+
+void SVL::UploadQueue::reset_recorder(uint32_t recorder)
+{
+	//the command buffers stay allocated and are begun again by the next batch
+	ErrorCheck(vkResetCommandPool(vk_renderer.device(), recorders[recorder].transfer_command_pool, 0));
+	if (recorders[recorder].graphics_command_pool != VK_NULL_HANDLE)
+		ErrorCheck(vkResetCommandPool(vk_renderer.device(), recorders[recorder].graphics_command_pool, 0));
+	free_recorders.push_back(recorder);
+}
+
+VkCommandBuffer SVL::UploadQueue::begin_command_buffer(VkCommandPool command_pool, VkCommandBuffer& command_buffer)
+{
+	if (command_buffer == VK_NULL_HANDLE)
+	{
+		VkCommandBufferAllocateInfo allocation_info = {};
+		allocation_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocation_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocation_info.commandPool = command_pool;
+		allocation_info.commandBufferCount = 1;
+		ErrorCheck(vkAllocateCommandBuffers(vk_renderer.device(), &allocation_info, &command_buffer));
+	}
+
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	ErrorCheck(vkBeginCommandBuffer(command_buffer, &begin_info));
+	return command_buffer;
+}
@@ -0,0 +1,118 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace SVL
+{
+	class Renderer;
+	class Image;
+
+	//records copies and layout transitions into one command buffer, submitted once
+	//each open batch records into command pools of its own, so different batches may be recorded on different threads at once
+	//one batch is used by one thread at a time, submits hold the renderer queue mutexes like the window's submit and present
+	class DLLDIR UploadBatch
+	{
+	public:
+		UploadBatch(const Renderer& renderer);
+		~UploadBatch(); //submits if submit() was not called
+
+		UploadBatch(const UploadBatch&) = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+		UploadBatch(UploadBatch&&) = delete;
+		UploadBatch& operator=(UploadBatch&&) = delete;
+
+		void copy_buffer(const void* source, VkDeviceSize size, VkBuffer destination, VkDeviceSize destination_offset = 0);
+		//region buffer offsets are relative to source
+		void copy_buffer_to_image(const void* source, VkDeviceSize size, Image& image, std::vector<VkBufferImageCopy> regions);
+		void copy_buffer_to_image(const void* source, VkDeviceSize size, Image& image, VkImageAspectFlags aspect);
+		//transitions out of transfer layouts hand the image over to the graphics queue
+		void transition_image_layout(Image& image, VkImageLayout new_layout, VkImageAspectFlags aspect);
+		//expects level 0 copied and every level in transfer dst layout, blits each level from the previous one
+		//on the graphics queue, the image ends up shader read only; the format must support linear blits
+		void generate_mipmaps(Image& image, VkImageAspectFlags aspect);
+		static bool can_generate_mipmaps(const Renderer& renderer, VkFormat format);
+
+		//copies are recorded on the transfer queue, acquire barriers on the graphics queue
+		const VkCommandBuffer command_buffer() const { return vk_transfer_command_buffer; }
+		const VkCommandBuffer graphics_command_buffer() const { return vk_graphics_command_buffer; }
+
+		//returns completion token for UploadQueue::wait/is_complete
+		uint64_t submit();
+	private:
+		const class Renderer& vk_renderer;
+		uint32_t vk_recorder = UINT32_MAX;
+		VkCommandBuffer vk_transfer_command_buffer = VK_NULL_HANDLE;
+		VkCommandBuffer vk_graphics_command_buffer = VK_NULL_HANDLE; //null without a separate transfer family
+		bool recorded = false;
+		bool submitted = false;
+	};
+
+	class DLLDIR UploadQueue
+	{
+	public:
+		UploadQueue(const Renderer& renderer);
+		~UploadQueue();
+
+		UploadQueue(const UploadQueue&) = delete;
+		UploadQueue& operator=(const UploadQueue&) = delete;
+		UploadQueue(UploadQueue&&) = delete;
+		UploadQueue& operator=(UploadQueue&&) = delete;
+
+		bool is_complete(uint64_t token);
+		void wait(uint64_t token);
+		void wait_idle();
+
+		const bool ownership_transfer() const { return separate_transfer_family; }
+	private:
+		friend class UploadBatch;
+
+		//command pools need external synchronization, a recorder belongs to one batch until its submission retires
+		struct Recorder
+		{
+			VkCommandPool transfer_command_pool = VK_NULL_HANDLE;
+			VkCommandPool graphics_command_pool = VK_NULL_HANDLE; //null without a separate transfer family
+			VkCommandBuffer transfer_command_buffer = VK_NULL_HANDLE;
+			VkCommandBuffer graphics_command_buffer = VK_NULL_HANDLE;
+		};
+		struct Submission
+		{
+			uint32_t recorder;
+			VkSemaphore semaphore;
+			VkFence fence;
+			uint64_t token;
+		};
+
+		const class Renderer& vk_renderer;
+
+		bool separate_transfer_family = false;
+
+		std::vector<Recorder> recorders;
+		std::vector<uint32_t> free_recorders;
+		std::vector<VkSemaphore> free_semaphores;
+		std::vector<VkFence> free_fences;
+		std::deque<Submission> pending;
+
+		uint64_t next_token = 1;
+		uint64_t completed_token = 0;
+		uint32_t open_batches = 0;
+		std::mutex mutex;
+
+		uint32_t begin(VkCommandBuffer& transfer_command_buffer, VkCommandBuffer& graphics_command_buffer);
+		uint64_t submit(uint32_t recorder);
+		void release(uint32_t recorder);
+		void close_batch();
+		void retire(bool wait);
+
+		uint32_t create_recorder();
+		void reset_recorder(uint32_t recorder);
+		VkCommandBuffer begin_command_buffer(VkCommandPool command_pool, VkCommandBuffer& command_buffer);
+	};
+}
+
+#endif // !UPLOAD_H
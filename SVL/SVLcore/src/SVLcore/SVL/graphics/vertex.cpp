@@ -38,5 +38,29 @@ std::array<VkVertexInputAttributeDescription, 5> SVL::Vertex3D::attribute_descri
 	attribute_descriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
 	attribute_descriptions[4].offset = offsetof(Vertex3D, tangent);
 
+	return attribute_descriptions;
+}
+
+VkVertexInputBindingDescription SVL::Instance3D::binding_descriptor()
+{
+	VkVertexInputBindingDescription binding_descriptor{};
+	binding_descriptor.binding = 1;
+	binding_descriptor.stride = sizeof(Instance3D);
+	binding_descriptor.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	return binding_descriptor;
+}
+std::array<VkVertexInputAttributeDescription, 4> SVL::Instance3D::attribute_descriptor()
+{
+	std::array<VkVertexInputAttributeDescription, 4> attribute_descriptions{};
+
+	for (uint32_t i = 0; i < attribute_descriptions.size(); i++)
+	{
+		attribute_descriptions[i].binding = 1;
+		attribute_descriptions[i].location = 5 + i;
+		attribute_descriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attribute_descriptions[i].offset = offsetof(Instance3D, transform) + i * sizeof(glm::vec4);
+	}
+
 	return attribute_descriptions;
 }
\ No newline at end of file
@@ -25,5 +25,15 @@ namespace SVL
 			return position == other.position && color == other.color && tex_coord == other.tex_coord && normal == other.normal && other.tangent == tangent;
 		}
 	};
+
+	//per instance, binding 1, locations 5-8 - one vec4 per matrix column
+	class DLLDIR Instance3D final
+	{
+	public:
+		glm::mat4 transform;
+
+		static VkVertexInputBindingDescription binding_descriptor();
+		static std::array<VkVertexInputAttributeDescription, 4> attribute_descriptor();
+	};
 }
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "window.h"
 #include "renderer.h"
 #include "tools.h"
+#include "thread_pool.h"
 
 #include <SVL/common/ErrorHandler.h>
 #include <array>
@@ -17,12 +18,13 @@ SVL::Window::Window(const Renderer& r, std::function<VkSurfaceKHR()> create_surf
 	create_resolve_resources();
 	create_renderpass();
 	create_framebuffers();
-	create_command_buffers(vk_swapchain_image_count);
+	create_command_buffers(frames_in_flight());
 	create_semaphores();
 }
 
 SVL::Window::~Window()
 {
+	delete vk_thread_pool;
 	destroy_semaphores();
 	destroy_command_buffers();
 	destroy_framebuffers();
@@ -38,7 +40,10 @@ void SVL::Window::update()
 	if(vk_extent.width == 0 || vk_extent.height == 0)
 		return;
 	
-	ErrorCheck(vkQueueWaitIdle(vk_renderer.queue()));
+	{
+		std::lock_guard<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.queue()));
+		ErrorCheck(vkQueueWaitIdle(vk_renderer.queue()));
+	}
 
 	destroy_command_buffers();
 	destroy_framebuffers();
@@ -54,11 +59,12 @@ void SVL::Window::update()
 	create_resolve_resources();
 	create_renderpass();
 	create_framebuffers();
+	vk_image_fences.assign(vk_swapchain_image_count, VK_NULL_HANDLE);
 	for(SecCommand* c : vk_sec_command_buffers)
 	{
 		c->update();
 	}
-	create_command_buffers(vk_swapchain_image_count);
+	create_command_buffers(frames_in_flight());
 }
 
 
@@ -71,7 +77,7 @@ void SVL::Window::draw()
 	pre_draw();
 
 	uint32_t image_index;
-	VkResult result = vkAcquireNextImageKHR(vk_renderer.device(), vk_swapchain, UINT64_MAX, vk_image_available_semaphore, VK_NULL_HANDLE, &image_index);
+	VkResult result = vkAcquireNextImageKHR(vk_renderer.device(), vk_swapchain, UINT64_MAX, vk_image_available_semaphores[vk_frame_index], VK_NULL_HANDLE, &image_index);
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		update();
@@ -82,38 +88,39 @@ void SVL::Window::draw()
 		Error("SVL ERROR: failed to acquire swapchain image.");
 	}
 
-	update_command_buffers(image_index);
+	//the image may still be used by a frame other than the one last submitted from this slot
+	if (vk_image_fences[image_index] != VK_NULL_HANDLE && vk_image_fences[image_index] != vk_fences[vk_frame_index])
+		ErrorCheck(vkWaitForFences(vk_renderer.device(), 1, &vk_image_fences[image_index], VK_TRUE, UINT64_MAX));
+	vk_image_fences[image_index] = vk_fences[vk_frame_index];
+
+	update_command_buffers(vk_frame_index, image_index);
 
 	VkSubmitInfo main_submit{};
 	main_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	VkPipelineStageFlags wait_stages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 	main_submit.waitSemaphoreCount = 1;
-	main_submit.pWaitSemaphores = &vk_image_available_semaphore;
+	main_submit.pWaitSemaphores = &vk_image_available_semaphores[vk_frame_index];
 	main_submit.pWaitDstStageMask = &wait_stages;
 	main_submit.commandBufferCount = 1;
-	main_submit.pCommandBuffers = &vk_command_buffers[image_index];
+	main_submit.pCommandBuffers = &vk_command_buffers[vk_frame_index];
 
 	main_submit.signalSemaphoreCount = 1;
-	main_submit.pSignalSemaphores = &vk_render_finished_semaphore;
+	main_submit.pSignalSemaphores = &vk_render_finished_semaphores[vk_frame_index];
 
-	ErrorCheck(vkQueueSubmit(vk_renderer.queue(), 1, &main_submit, vk_fence));
-
-	VkResult fence_result;
-	do
-	{
-		fence_result = vkWaitForFences(vk_renderer.device(), 1, &vk_fence, VK_TRUE, UINT64_MAX);
-	} while (fence_result == VK_TIMEOUT);
-	vkResetFences(vk_renderer.device(), 1, &vk_fence);
+	ErrorCheck(vkResetFences(vk_renderer.device(), 1, &vk_fences[vk_frame_index]));
+	std::unique_lock<std::mutex> queue_lock(vk_renderer.queue_mutex(vk_renderer.queue()));
+	ErrorCheck(vkQueueSubmit(vk_renderer.queue(), 1, &main_submit, vk_fences[vk_frame_index]));
 
 	VkPresentInfoKHR present_info{};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	present_info.waitSemaphoreCount = 1;
-	present_info.pWaitSemaphores = &vk_render_finished_semaphore;
+	present_info.pWaitSemaphores = &vk_render_finished_semaphores[vk_frame_index];
 	present_info.swapchainCount = 1;
 	present_info.pSwapchains = &vk_swapchain;
 	present_info.pImageIndices = &image_index;
 
 	result = vkQueuePresentKHR(vk_renderer.queue(), &present_info);
+	queue_lock.unlock();
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
 	{
@@ -124,6 +131,10 @@ void SVL::Window::draw()
 		Error("SVL ERROR: failed to present swapchain image.");
 	}
 
+	//wait until the next frame slot is free, its uniforms and command buffers can be written after draw returns
+	vk_frame_index = (vk_frame_index + 1) % frames_in_flight();
+	ErrorCheck(vkWaitForFences(vk_renderer.device(), 1, &vk_fences[vk_frame_index], VK_TRUE, UINT64_MAX));
+
 	post_draw();
 }
 
@@ -139,6 +150,14 @@ void SVL::Window::set_msaa(AntiAliasing aa)
 	this->update();
 }
 
+void SVL::Window::set_parallel_recording(bool enable, uint32_t thread_count)
+{
+	delete vk_thread_pool;
+	vk_thread_pool = nullptr;
+	if (enable)
+		vk_thread_pool = thread_count == 0 ? new ThreadPool() : new ThreadPool(thread_count);
+}
+
 void SVL::Window::add_command(SecCommand* com)
 {
 	vk_sec_command_buffers.push_back(com);
@@ -520,13 +539,13 @@ void SVL::Window::destroy_framebuffers()
 	vk_framebuffers.clear();
 }
 
-void SVL::Window::update_command_buffers(uint32_t index)
+void SVL::Window::update_command_buffers(uint32_t frame, uint32_t image_index)
 {
 	if (vk_extent.width == 0 || vk_extent.height == 0) return;
 
 	VkCommandBufferBeginInfo command_buffer_begin_info{};
 	command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	VkRenderPassBeginInfo render_pass_begin_info{};
 	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -551,51 +570,93 @@ void SVL::Window::update_command_buffers(uint32_t index)
 	}
 	render_pass_begin_info.clearValueCount = (uint32_t)clear_values.size();
 	render_pass_begin_info.pClearValues = clear_values.data();
-	render_pass_begin_info.framebuffer = vk_framebuffers[index];
+	render_pass_begin_info.framebuffer = vk_framebuffers[image_index];
 
-	ErrorCheck(vkBeginCommandBuffer(vk_command_buffers[index], &command_buffer_begin_info));
+	ErrorCheck(vkBeginCommandBuffer(vk_command_buffers[frame], &command_buffer_begin_info));
+
+	for(SecCommand* com : vk_sec_command_buffers)
+		com->record_pre_render_pass(vk_command_buffers[frame], frame);
 
-	vkCmdBeginRenderPass(vk_command_buffers[index], &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	vkCmdBeginRenderPass(vk_command_buffers[frame], &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
 	VkCommandBufferInheritanceInfo inheritance_info{};
 	inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
 	inheritance_info.renderPass = (*vk_render_pass)();
-	inheritance_info.framebuffer = vk_framebuffers[index];
-	//inheritance_info.framebuffer = VK_NULL_HANDLE;
+	//secondaries may be kept across frames and replayed on any swapchain image
+	inheritance_info.framebuffer = VK_NULL_HANDLE;
 
-	pre_update_command_buffers(vk_command_buffers[index], inheritance_info, index);
+	pre_update_command_buffers(vk_command_buffers[frame], inheritance_info, frame);
+
+	if (vk_thread_pool != nullptr)
+	{
+		for(SecCommand* com : vk_sec_command_buffers)
+			com->record_command_buffers(inheritance_info, frame, *vk_thread_pool);
+		vk_thread_pool->wait();
+	}
+	else
+	{
+		for(SecCommand* com : vk_sec_command_buffers)
+			com->update_command_buffers(inheritance_info, frame);
+	}
 
 	std::vector<VkCommandBuffer> secondary_cmd_buffers;
 	for(SecCommand* com : vk_sec_command_buffers)
 	{
-		com->update_command_buffers(inheritance_info, index);
-		if(!com->command_buffers().empty())
-			secondary_cmd_buffers.push_back(com->command_buffers()[index]);
+		std::vector<VkCommandBuffer> buffers = com->secondary_command_buffers(frame);
+		secondary_cmd_buffers.insert(secondary_cmd_buffers.end(), buffers.begin(), buffers.end());
 	}
-	vkCmdExecuteCommands(vk_command_buffers[index], secondary_cmd_buffers.size(), secondary_cmd_buffers.data());
+	if (!secondary_cmd_buffers.empty())
+		vkCmdExecuteCommands(vk_command_buffers[frame], secondary_cmd_buffers.size(), secondary_cmd_buffers.data());
 	
-	post_update_command_buffers(vk_command_buffers[index], inheritance_info, index);
+	post_update_command_buffers(vk_command_buffers[frame], inheritance_info, frame);
 
-	vkCmdEndRenderPass(vk_command_buffers[index]);
+	vkCmdEndRenderPass(vk_command_buffers[frame]);
 
-	ErrorCheck(vkEndCommandBuffer(vk_command_buffers[index]));
+	ErrorCheck(vkEndCommandBuffer(vk_command_buffers[frame]));
 }
 
 void SVL::Window::create_semaphores()
 {
 	VkSemaphoreCreateInfo semaphore_info{};
 	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	ErrorCheck(vkCreateSemaphore(vk_renderer.device(), &semaphore_info, nullptr, &vk_image_available_semaphore));
-	ErrorCheck(vkCreateSemaphore(vk_renderer.device(), &semaphore_info, nullptr, &vk_render_finished_semaphore));
 	VkFenceCreateInfo fence_info{};
 	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	ErrorCheck(vkCreateFence(vk_renderer.device(), &fence_info, nullptr, &vk_fence));
+	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	vk_image_available_semaphores.resize(frames_in_flight());
+	vk_render_finished_semaphores.resize(frames_in_flight());
+	vk_fences.resize(frames_in_flight());
+	for (uint32_t i = 0; i < frames_in_flight(); i++)
+	{
+		ErrorCheck(vkCreateSemaphore(vk_renderer.device(), &semaphore_info, nullptr, &vk_image_available_semaphores[i]));
+		ErrorCheck(vkCreateSemaphore(vk_renderer.device(), &semaphore_info, nullptr, &vk_render_finished_semaphores[i]));
+		ErrorCheck(vkCreateFence(vk_renderer.device(), &fence_info, nullptr, &vk_fences[i]));
+	}
+	vk_image_fences.assign(vk_swapchain_image_count, VK_NULL_HANDLE);
 }
 void SVL::Window::destroy_semaphores()
 {
-	vkDestroyFence(vk_renderer.device(), vk_fence, nullptr);
-	vkDestroySemaphore(vk_renderer.device(), vk_render_finished_semaphore, nullptr);
-	vkDestroySemaphore(vk_renderer.device(), vk_image_available_semaphore, nullptr);
+	wait_idle();
+	for (uint32_t i = 0; i < vk_fences.size(); i++)
+	{
+		vkDestroyFence(vk_renderer.device(), vk_fences[i], nullptr);
+		vkDestroySemaphore(vk_renderer.device(), vk_render_finished_semaphores[i], nullptr);
+		vkDestroySemaphore(vk_renderer.device(), vk_image_available_semaphores[i], nullptr);
+	}
+	vk_fences.clear();
+	vk_render_finished_semaphores.clear();
+	vk_image_available_semaphores.clear();
+	vk_image_fences.clear();
+}
+
+void SVL::Window::wait_idle() const
+{
+	ErrorCheck(vkWaitForFences(vk_renderer.device(), vk_fences.size(), vk_fences.data(), VK_TRUE, UINT64_MAX));
+}
+
+const uint32_t SVL::Window::frames_in_flight() const
+{
+	return vk_renderer.frames_in_flight();
 }
 
 const VkSampleCountFlagBits SVL::Window::get_sample_count() const
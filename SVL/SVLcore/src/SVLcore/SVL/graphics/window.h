@@ -20,6 +20,7 @@ namespace SVL
 	};
 
 	class Renderer;
+	class ThreadPool;
 	class DLLDIR Window : public PrimCommand
 	{
 	public:
@@ -33,21 +34,30 @@ namespace SVL
 
 		void update();
 		void draw();
+		//waits for all frames in flight, call before destroying resources they use
+		void wait_idle() const;
 
 		void add_command(SecCommand*);
 		void del_command(SecCommand*);
 
 		void set_extent(uint32_t width, uint32_t height);
 		void set_msaa(AntiAliasing aa);
+		//records secondary command buffers on worker threads, thread_count 0 uses all cores
+		void set_parallel_recording(bool enable, uint32_t thread_count = 0);
 
 		const Renderer& renderer() const { return vk_renderer; }
 		const VkExtent2D extent() const { return vk_extent; }
 		const VkSurfaceFormatKHR surface_format() const { return vk_surface_format; }
 		const uint32_t image_count() const { return vk_swapchain_image_count; }
+		//secondary command buffers and per frame data are indexed by frame, not by swapchain image
+		const uint32_t frames_in_flight() const;
+		const uint32_t frame_index() const { return vk_frame_index; }
 		const VkRenderPass& render_pass() const { return (*vk_render_pass)(); }
+		const uint64_t render_pass_hash() const { return vk_render_pass->compatibility_hash(); }
 		const std::vector<VkFramebuffer>* framebuffers() const { return &vk_framebuffers; }
 		
 		const VkSampleCountFlagBits get_sample_count() const;
+		const bool parallel_recording() const { return vk_thread_pool != nullptr; }
 	protected:
 		virtual void pre_draw() {}
 		virtual void post_draw() {}
@@ -77,11 +87,14 @@ namespace SVL
 
 		std::vector<VkFramebuffer> vk_framebuffers;
 
-		VkSemaphore vk_image_available_semaphore;
-		VkSemaphore vk_render_finished_semaphore;
-		VkFence vk_fence;
+		std::vector<VkSemaphore> vk_image_available_semaphores;
+		std::vector<VkSemaphore> vk_render_finished_semaphores;
+		std::vector<VkFence> vk_fences;
+		std::vector<VkFence> vk_image_fences; //fence of the frame last rendered to each swapchain image
+		uint32_t vk_frame_index = 0;
 
 		std::vector<SecCommand*> vk_sec_command_buffers;
+		ThreadPool* vk_thread_pool = nullptr;
 			
 
 		void create_surface();
@@ -106,7 +119,7 @@ namespace SVL
 		void create_semaphores();
 		void destroy_semaphores();
 
-		void update_command_buffers(uint32_t index);
+		void update_command_buffers(uint32_t frame, uint32_t image_index);
 	};
 }
 #endif // !window_h
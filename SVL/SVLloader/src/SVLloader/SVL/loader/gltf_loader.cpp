@@ -5,6 +5,8 @@
 #include <SVL/graphics/window.h>
 #include <SVL/graphics/model.h>
 #include <SVL/graphics/texture.h>
+#include <SVL/graphics/upload.h>
+#include "texture_compressor.h"
 
 #define TINYGLTF_IMPLEMENTATION
 #define TINYGLTF_NO_STB_IMAGE_WRITE
@@ -129,7 +131,26 @@ SVL::Mesh process_mesh(const tinygltf::Model& model, const tinygltf::Mesh mesh)
 	return m;
 }
 
-SVL::Material process_material(const SVL::Renderer& renderer, const VkCommandPool& command_pool, const tinygltf::Model& model, const tinygltf::Material material)
+SVL::Texture* process_texture(const SVL::Renderer& renderer, SVL::UploadBatch& upload, SVL::TextureCompressor* compressor, const tinygltf::Image& img, SVL::TextureContent content)
+{
+	VkExtent2D extent{ static_cast<uint32_t>(img.width), static_cast<uint32_t>(img.height) };
+	if (compressor && img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && img.component == 4)
+	{
+		SVL::Texture* texture = compressor->create_texture(upload, img.image.data(), extent, content);
+		if (texture)
+			return texture;
+	}
+
+	VkFormat format{};
+	if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+		format = VK_FORMAT_R8G8B8A8_UNORM;
+	else if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+		format = VK_FORMAT_R16G16B16A16_UNORM;
+
+	return new SVL::Texture(renderer, upload, static_cast<const void*>(img.image.data()), img.image.size(), extent, format);
+}
+
+SVL::Material process_material(const SVL::Renderer& renderer, SVL::UploadBatch& upload, SVL::TextureCompressor* compressor, const tinygltf::Model& model, const tinygltf::Material material)
 {
 	SVL::Material::MaterialTextures tex{};
 	SVL::Material::MaterialProperties prop{};
@@ -139,13 +160,7 @@ SVL::Material process_material(const SVL::Renderer& renderer, const VkCommandPoo
 		const tinygltf::Texture t = model.textures[material.pbrMetallicRoughness.baseColorTexture.index];
 		const tinygltf::Image img = model.images[t.source];
 
-		VkFormat format{};
-		if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-			format = VK_FORMAT_R8G8B8A8_UNORM;
-		else if(img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-			format = VK_FORMAT_R16G16B16A16_UNORM;
-
-		tex.diffuse = new SVL::Texture(renderer, command_pool, static_cast<const void*>(img.image.data()), img.image.size(), { static_cast<uint32_t>(img.width), static_cast<uint32_t>(img.height) }, format);
+		tex.diffuse = process_texture(renderer, upload, compressor, img, SVL::ColorTexture);
 	}
 
 	if (material.normalTexture.index >= 0)
@@ -153,14 +168,8 @@ SVL::Material process_material(const SVL::Renderer& renderer, const VkCommandPoo
 		const tinygltf::Texture t = model.textures[material.normalTexture.index];
 		const tinygltf::Image img = model.images[t.source];
 
-		VkFormat format{};
-		if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-			format = VK_FORMAT_R8G8B8A8_UNORM;
-		else if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-			format = VK_FORMAT_R16G16B16A16_UNORM;
-
 		prop.has_normal_tex = true;
-		tex.normal = new SVL::Texture(renderer, command_pool, static_cast<const void*>(img.image.data()), img.image.size(), { static_cast<uint32_t>(img.width), static_cast<uint32_t>(img.height) }, format);
+		tex.normal = process_texture(renderer, upload, compressor, img, SVL::NormalTexture);
 	}
 
 	if (material.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0)
@@ -168,14 +177,10 @@ SVL::Material process_material(const SVL::Renderer& renderer, const VkCommandPoo
 		const tinygltf::Texture t = model.textures[material.pbrMetallicRoughness.metallicRoughnessTexture.index];
 		const tinygltf::Image img = model.images[t.source];
 
-		VkFormat format{};
-		if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-			format = VK_FORMAT_R8G8B8A8_UNORM;
-		else if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-			format = VK_FORMAT_R16G16B16A16_UNORM;
-
 		prop.has_ao_tex = 1;
-		tex.metalness_roughness = new SVL::Texture(renderer, command_pool, static_cast<const void*>(img.image.data()), img.image.size(), { static_cast<uint32_t>(img.width), static_cast<uint32_t>(img.height) }, format);
+		//occlusion is read from r unless the material has its own occlusion texture
+		SVL::TextureContent content = material.occlusionTexture.index >= 0 ? SVL::MetalRoughTexture : SVL::OcclusionMetalRoughTexture;
+		tex.metalness_roughness = process_texture(renderer, upload, compressor, img, content);
 	}
 
 	if (material.occlusionTexture.index >= 0)
@@ -183,14 +188,8 @@ SVL::Material process_material(const SVL::Renderer& renderer, const VkCommandPoo
 		const tinygltf::Texture t = model.textures[material.occlusionTexture.index];
 		const tinygltf::Image img = model.images[t.source];
 
-		VkFormat format{};
-		if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-			format = VK_FORMAT_R8G8B8A8_UNORM;
-		else if (img.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-			format = VK_FORMAT_R16G16B16A16_UNORM;
-
 		prop.has_ao_tex = 2;
-		tex.ambient_occulsion = new SVL::Texture(renderer, command_pool, static_cast<const void*>(img.image.data()), img.image.size(), { static_cast<uint32_t>(img.width), static_cast<uint32_t>(img.height) }, format);
+		tex.ambient_occulsion = process_texture(renderer, upload, compressor, img, SVL::OcclusionTexture);
 	}
 	
 	return SVL::Material(renderer, tex, prop);
@@ -227,9 +226,12 @@ SVL::Model SVL::Loader::load_gltf(VkCommandPool command_pool, std::string filena
 	std::vector<SVL::Mesh> meshes;
 	std::vector<SVL::Material> materials;
 
+	//all textures and geometry of the file go out in one submit
+	UploadBatch upload(vk_renderer);
+
 	for (auto mat : model.materials)
 	{
-		materials.push_back(process_material(vk_renderer, command_pool, model, mat));
+		materials.push_back(process_material(vk_renderer, upload, compressor, model, mat));
 	}
 
 
@@ -253,5 +255,5 @@ SVL::Model SVL::Loader::load_gltf(VkCommandPool command_pool, std::string filena
 		index_offset += mesh.indices.size();
 	}
 	
-	return Model(vk_renderer, command_pool, meshes, materials);
+	return Model(vk_renderer, upload, meshes, materials);
 }
\ No newline at end of file
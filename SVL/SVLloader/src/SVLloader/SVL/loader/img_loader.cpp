@@ -1,6 +1,8 @@
 #include "loader.h"
 
 #include <SVL/graphics/texture.h>
+#include <SVL/graphics/upload.h>
+#include "texture_compressor.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <SVL/external/stb_image.h>
 
@@ -15,6 +17,19 @@ SVL::Texture* SVL::Loader::load_img(VkFormat format, VkCommandPool command_pool,
 	if (!image)
 		return nullptr;
 
+	if (compressor && format == VK_FORMAT_R8G8B8A8_UNORM)
+	{
+		UploadBatch upload(vk_renderer);
+		Texture* texture = compressor->create_texture(upload, image, { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }, ColorTexture);
+		upload.submit();
+		if (texture)
+		{
+			stbi_image_free(image);
+			return textures[filename] = texture;
+		}
+	}
+
 	textures[filename] = new Texture(vk_renderer, command_pool, static_cast<void*>(image), width * height * 4, { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }, format);
+	stbi_image_free(image);
 	return textures[filename];
 }
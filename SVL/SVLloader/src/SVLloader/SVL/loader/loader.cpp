@@ -1,9 +1,17 @@
 #include "loader.h"
 
 #include <SVL/graphics/texture.h>
+#include "texture_compressor.h"
 
 SVL::Loader::~Loader()
 {
 	for(auto tex : textures)
 		delete tex.second;
+	delete compressor;
+}
+
+void SVL::Loader::enable_texture_compression(std::string cache_directory, bool fast)
+{
+	delete compressor;
+	compressor = new TextureCompressor(vk_renderer, cache_directory, fast);
 }
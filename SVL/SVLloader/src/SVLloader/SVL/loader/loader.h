@@ -13,6 +13,7 @@ namespace SVL
 	class Window;
 	class Model;
 	class Texture;
+	class TextureCompressor;
 	class DLLDIR Loader final
 	{
 	public:
@@ -23,8 +24,12 @@ namespace SVL
 		Texture* load_img(VkFormat format, VkCommandPool command_pool, std::string filename);
 		Texture* load_ktx(VkFormat format, VkCommandPool command_pool, std::string filename);
 		Texture* load_cubemap_ktx(VkFormat format, VkCommandPool command_pool, std::string filename);
+
+		//8 bit textures of later load_img and load_gltf calls are block compressed, see TextureCompressor
+		void enable_texture_compression(std::string cache_directory = "", bool fast = false);
 	private:
 		const class Renderer& vk_renderer;
+		TextureCompressor* compressor = nullptr;
 
 		std::unordered_map<std::string, Texture*> textures;
 	};
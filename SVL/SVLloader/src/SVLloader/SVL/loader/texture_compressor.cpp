@@ -0,0 +1,566 @@
+#include "texture_compressor.h"
+
+#include <SVL/common/ErrorHandler.h>
+#include <SVL/common/FileReplace.h>
+#include <SVL/graphics/hash.h>
+#include <SVL/graphics/image.h>
+#include <SVL/graphics/renderer.h>
+#include <SVL/graphics/texture.h>
+#include <SVL/graphics/thread_pool.h>
+#include <SVL/graphics/upload.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define SVL_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace
+{
+	const uint32_t cache_magic = 0x424C5653; //"SVLB"
+	const uint32_t cache_version = 1;
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mip_levels;
+		uint64_t size;
+	};
+
+	const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	uint32_t block_size(VkFormat format)
+	{
+		return format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC4_UNORM_BLOCK ? 8 : 16;
+	}
+
+	VkExtent2D level_extent(VkExtent2D extent, uint32_t level)
+	{
+		return { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+	}
+
+	//bytes of the whole chain, offsets of each level when asked
+	VkDeviceSize chain_size(VkExtent2D extent, uint32_t mip_levels, VkFormat format, std::vector<VkDeviceSize>* offsets = nullptr)
+	{
+		VkDeviceSize size = 0;
+		for (uint32_t level = 0; level < mip_levels; level++)
+		{
+			if (offsets)
+				offsets->push_back(size);
+			VkExtent2D e = level_extent(extent, level);
+			size += (VkDeviceSize)((e.width + 3) / 4) * ((e.height + 3) / 4) * block_size(format);
+		}
+		return size;
+	}
+
+	//2x2 box filter, odd edges repeat the last texel
+	void downsample(const uint8_t* source, VkExtent2D source_extent, uint8_t* destination, VkExtent2D extent)
+	{
+		for (uint32_t y = 0; y < extent.height; y++)
+		{
+			const uint8_t* row0 = source + (size_t)std::min(y * 2, source_extent.height - 1) * source_extent.width * 4;
+			const uint8_t* row1 = source + (size_t)std::min(y * 2 + 1, source_extent.height - 1) * source_extent.width * 4;
+			for (uint32_t x = 0; x < extent.width; x++)
+			{
+				uint32_t x0 = std::min(x * 2, source_extent.width - 1) * 4;
+				uint32_t x1 = std::min(x * 2 + 1, source_extent.width - 1) * 4;
+				for (uint32_t c = 0; c < 4; c++)
+					destination[((size_t)y * extent.width + x) * 4 + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+
+	//4x4 texels from x, y, edges repeat the last row and column
+	void fetch_block(const uint8_t* pixels, VkExtent2D extent, uint32_t x, uint32_t y, uint8_t block[64])
+	{
+		for (uint32_t j = 0; j < 4; j++)
+		{
+			const uint8_t* row = pixels + (size_t)std::min(y + j, extent.height - 1) * extent.width * 4;
+			for (uint32_t i = 0; i < 4; i++)
+				memcpy(block + (j * 4 + i) * 4, row + std::min(x + i, extent.width - 1) * 4, 4);
+		}
+	}
+
+	//per channel minimum and maximum of the block
+	void block_bounds(const uint8_t block[64], uint8_t low[4], uint8_t high[4])
+	{
+#ifdef SVL_SSE2
+		__m128i row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+		__m128i row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+		__m128i row2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32));
+		__m128i row3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48));
+		__m128i lowest = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+		__m128i highest = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+		//fold the four texels of a register into one
+		lowest = _mm_min_epu8(lowest, _mm_shuffle_epi32(lowest, _MM_SHUFFLE(1, 0, 3, 2)));
+		lowest = _mm_min_epu8(lowest, _mm_shuffle_epi32(lowest, _MM_SHUFFLE(2, 3, 0, 1)));
+		highest = _mm_max_epu8(highest, _mm_shuffle_epi32(highest, _MM_SHUFFLE(1, 0, 3, 2)));
+		highest = _mm_max_epu8(highest, _mm_shuffle_epi32(highest, _MM_SHUFFLE(2, 3, 0, 1)));
+		int texel = _mm_cvtsi128_si32(lowest);
+		memcpy(low, &texel, 4);
+		texel = _mm_cvtsi128_si32(highest);
+		memcpy(high, &texel, 4);
+#else
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			low[c] = 255;
+			high[c] = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				low[c] = std::min(low[c], block[i * 4 + c]);
+				high[c] = std::max(high[c], block[i * 4 + c]);
+			}
+		}
+#endif
+	}
+
+	//bounding box corners on the block's main diagonal, channels falling while the widest one rises are swapped
+	void block_endpoints(const uint8_t block[64], uint32_t channels, int e0[4], int e1[4])
+	{
+		uint8_t low[4], high[4];
+		block_bounds(block, low, high);
+
+		uint32_t widest = 0;
+		for (uint32_t c = 1; c < channels; c++)
+			if (high[c] - low[c] > high[widest] - low[widest])
+				widest = c;
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			e0[c] = low[c];
+			e1[c] = high[c];
+		}
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			if (c == widest)
+				continue;
+			int covariance = 0;
+			for (uint32_t i = 0; i < 16; i++)
+				covariance += (2 * block[i * 4 + widest] - low[widest] - high[widest]) * (2 * block[i * 4 + c] - low[c] - high[c]);
+			if (covariance < 0)
+				std::swap(e0[c], e1[c]);
+		}
+	}
+
+	uint16_t to_565(const int color[4])
+	{
+		return (uint16_t)((((color[0] * 31 + 127) / 255) << 11) | (((color[1] * 63 + 127) / 255) << 5) | ((color[2] * 31 + 127) / 255));
+	}
+
+	void from_565(uint16_t value, int color[4])
+	{
+		int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+		color[3] = 255;
+	}
+
+	//four colour mode only, also the colour half of bc3
+	void encode_bc1(const uint8_t block[64], uint8_t* output)
+	{
+		int e0[4], e1[4];
+		block_endpoints(block, 3, e0, e1);
+		//pull the corners in, the interpolated colours cover the box better than its ends
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			int inset = (e1[c] - e0[c]) / 16;
+			e0[c] += inset;
+			e1[c] -= inset;
+		}
+
+		uint16_t color0 = to_565(e1), color1 = to_565(e0);
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][4];
+			from_565(color0, palette[0]);
+			from_565(color1, palette[1]);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				int best_error = INT_MAX;
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					int error = 0;
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						int d = block[i * 4 + c] - palette[p][c];
+						error += d * d;
+					}
+					if (error < best_error)
+					{
+						best_error = error;
+						best = p;
+					}
+				}
+				indices |= best << (i * 2);
+			}
+		}
+
+		output[0] = (uint8_t)color0;
+		output[1] = (uint8_t)(color0 >> 8);
+		output[2] = (uint8_t)color1;
+		output[3] = (uint8_t)(color1 >> 8);
+		for (uint32_t b = 0; b < 4; b++)
+			output[4 + b] = (uint8_t)(indices >> (b * 8));
+	}
+
+	//eight value mode, also the alpha half of bc3 and each half of bc5
+	void encode_bc4(const uint8_t block[64], uint32_t channel, uint8_t* output)
+	{
+		uint8_t low[4], high[4];
+		block_bounds(block, low, high);
+		int lowest = low[channel], highest = high[channel];
+
+		output[0] = (uint8_t)highest;
+		output[1] = (uint8_t)lowest;
+		uint64_t indices = 0;
+		if (highest > lowest)
+		{
+			//index 0 is the highest value, 1 the lowest, 2 to 7 step from highest towards lowest
+			int range = highest - lowest;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				int position = ((block[i * 4 + channel] - lowest) * 7 + range / 2) / range;
+				uint64_t index = position == 7 ? 0 : position == 0 ? 1 : 8 - position;
+				indices |= index << (i * 3);
+			}
+		}
+		for (uint32_t b = 0; b < 6; b++)
+			output[2 + b] = (uint8_t)(indices >> (b * 8));
+	}
+
+	//mode 6 only, one subset with 7 bit rgba endpoints, a p bit each and 4 bit indices
+	void encode_bc7(const uint8_t block[64], uint8_t* output)
+	{
+		int e[2][4];
+		block_endpoints(block, 4, e[0], e[1]);
+
+		//the p bit is shared by the channels of an endpoint, keep the one closer to the box corner
+		int quantized[2][4], p[2] = { 0, 0 };
+		for (uint32_t n = 0; n < 2; n++)
+		{
+			int best_error = INT_MAX;
+			for (int bit = 0; bit < 2; bit++)
+			{
+				int q[4], error = 0;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					q[c] = std::min(std::max((e[n][c] - bit + 1) / 2, 0), 127);
+					int d = ((q[c] << 1) | bit) - e[n][c];
+					error += d * d;
+				}
+				if (error < best_error)
+				{
+					best_error = error;
+					p[n] = bit;
+					memcpy(quantized[n], q, sizeof(q));
+				}
+			}
+		}
+
+		int palette[16][4];
+		for (uint32_t w = 0; w < 16; w++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				int a = (quantized[0][c] << 1) | p[0];
+				int b = (quantized[1][c] << 1) | p[1];
+				palette[w][c] = ((64 - bc7_weights[w]) * a + bc7_weights[w] * b + 32) >> 6;
+			}
+		}
+
+		uint32_t indices[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int best_error = INT_MAX;
+			for (uint32_t w = 0; w < 16; w++)
+			{
+				int error = 0;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					int d = block[i * 4 + c] - palette[w][c];
+					error += d * d;
+				}
+				if (error < best_error)
+				{
+					best_error = error;
+					indices[i] = w;
+				}
+			}
+		}
+
+		//the first index is stored without its top bit, flip the endpoints when it is set
+		if (indices[0] & 8)
+		{
+			std::swap(quantized[0], quantized[1]);
+			std::swap(p[0], p[1]);
+			for (uint32_t i = 0; i < 16; i++)
+				indices[i] = 15 - indices[i];
+		}
+
+		uint64_t bits[2] = { 0, 0 };
+		uint32_t position = 0;
+		auto put = [&](uint64_t value, uint32_t count)
+		{
+			for (uint32_t b = 0; b < count; b++, position++)
+				bits[position / 64] |= ((value >> b) & 1) << (position % 64);
+		};
+		put(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			put(quantized[0][c], 7);
+			put(quantized[1][c], 7);
+		}
+		put(p[0], 1);
+		put(p[1], 1);
+		put(indices[0], 3);
+		for (uint32_t i = 1; i < 16; i++)
+			put(indices[i], 4);
+
+		for (uint32_t b = 0; b < 16; b++)
+			output[b] = (uint8_t)(bits[b / 8] >> ((b % 8) * 8));
+	}
+
+	void encode_block(const uint8_t block[64], VkFormat format, SVL::TextureContent content, uint8_t* output)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			encode_bc1(block, output);
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+			encode_bc4(block, 3, output);
+			encode_bc1(block, output + 8);
+			break;
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			encode_bc4(block, 0, output);
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			//normals keep x and y, metal rough keeps roughness from g and metalness from b
+			encode_bc4(block, content == SVL::NormalTexture ? 0 : 1, output);
+			encode_bc4(block, content == SVL::NormalTexture ? 1 : 2, output + 8);
+			break;
+		default:
+			encode_bc7(block, output);
+			break;
+		}
+	}
+}
+
+SVL::TextureCompressor::TextureCompressor(const Renderer& renderer, std::string cache_directory, bool fast)
+	: vk_renderer(renderer), cache_directory(cache_directory), fast(fast)
+{
+	pool = new ThreadPool();
+}
+
+SVL::TextureCompressor::~TextureCompressor()
+{
+	delete pool;
+}
+
+SVL::Texture* SVL::TextureCompressor::create_texture(UploadBatch& upload, const uint8_t* pixels, VkExtent2D extent, TextureContent content)
+{
+	Encoded encoded;
+	encoded.format = format(pixels, extent, content);
+	if (!supported(encoded.format))
+		return nullptr;
+	encoded.extent = extent;
+	encoded.mip_levels = 1;
+	for (uint32_t dimension = std::max(extent.width, extent.height); dimension > 1; dimension >>= 1)
+		encoded.mip_levels++;
+
+	//cached by the pixels and everything deciding their encoding
+	std::string path;
+	if (!cache_directory.empty())
+	{
+		Hasher hasher;
+		hasher.add(cache_version).add((uint32_t)content).add((uint32_t)encoded.format).add(extent.width).add(extent.height);
+		hasher.add(pixels, (size_t)extent.width * extent.height * 4);
+		std::stringstream name;
+		name << std::hex << std::setw(16) << std::setfill('0') << hasher.value();
+		path = cache_directory + "/" + name.str() + ".svlbc";
+	}
+	if (path.empty() || !load_cache(path, encoded))
+	{
+		encode(pixels, content, encoded);
+		if (!path.empty())
+			save_cache(path, encoded);
+	}
+
+	//image
+	ImageView image(vk_renderer);
+	image.create_2D_image(extent, encoded.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 1, encoded.mip_levels);
+	upload.transition_image_layout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	//copy buffer to image, the chain goes up as encoded
+	std::vector<VkDeviceSize> offsets;
+	chain_size(extent, encoded.mip_levels, encoded.format, &offsets);
+	std::vector<VkBufferImageCopy> regions;
+	for (uint32_t level = 0; level < encoded.mip_levels; level++)
+	{
+		VkExtent2D e = level_extent(extent, level);
+		VkBufferImageCopy region = {};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent.width = e.width;
+		region.imageExtent.height = e.height;
+		region.imageExtent.depth = 1;
+		region.bufferOffset = offsets[level];
+		regions.push_back(region);
+	}
+	upload.copy_buffer_to_image(encoded.data.data(), encoded.data.size(), image, regions);
+	upload.transition_image_layout(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	//view
+	if (content == MetalRoughTexture)
+		image.create_2D_image_view(VK_IMAGE_ASPECT_COLOR_BIT, { VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ONE });
+	else
+		image.create_2D_image_view(VK_IMAGE_ASPECT_COLOR_BIT);
+
+	return new Texture(vk_renderer, std::move(image));
+}
+
+VkFormat SVL::TextureCompressor::format(const uint8_t* pixels, VkExtent2D extent, TextureContent content) const
+{
+	switch (content)
+	{
+	case NormalTexture:
+	case MetalRoughTexture:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case OcclusionTexture:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case OcclusionMetalRoughTexture:
+		return fast ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	default:
+		if (!fast)
+			return VK_FORMAT_BC7_UNORM_BLOCK;
+		for (size_t i = 3; i < (size_t)extent.width * extent.height * 4; i += 4)
+			if (pixels[i] != 255)
+				return VK_FORMAT_BC3_UNORM_BLOCK;
+		return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	}
+}
+
+bool SVL::TextureCompressor::supported(VkFormat format) const
+{
+	if (!vk_renderer.features().textureCompressionBC)
+		return false;
+
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(vk_renderer.physical_device(), format, &properties);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+void SVL::TextureCompressor::encode(const uint8_t* pixels, TextureContent content, Encoded& encoded)
+{
+	//mip chain first, each level is then encoded in bands of block rows
+	std::vector<std::vector<uint8_t>> levels(encoded.mip_levels);
+	std::vector<const uint8_t*> sources(encoded.mip_levels, pixels);
+	for (uint32_t level = 1; level < encoded.mip_levels; level++)
+	{
+		VkExtent2D extent = level_extent(encoded.extent, level);
+		levels[level].resize((size_t)extent.width * extent.height * 4);
+		downsample(sources[level - 1], level_extent(encoded.extent, level - 1), levels[level].data(), extent);
+		sources[level] = levels[level].data();
+	}
+
+	std::vector<VkDeviceSize> offsets;
+	encoded.data.assign((size_t)chain_size(encoded.extent, encoded.mip_levels, encoded.format, &offsets), 0);
+
+	const VkFormat format = encoded.format;
+	const uint32_t block_bytes = block_size(format);
+	for (uint32_t level = 0; level < encoded.mip_levels; level++)
+	{
+		const VkExtent2D extent = level_extent(encoded.extent, level);
+		const uint32_t blocks_x = (extent.width + 3) / 4;
+		const uint32_t blocks_y = (extent.height + 3) / 4;
+		const uint8_t* source = sources[level];
+		uint8_t* destination = encoded.data.data() + offsets[level];
+		//a few bands per thread keep the pool busy when rows take uneven time
+		const uint32_t band = std::max(1u, blocks_y / (pool->size() * 4));
+		for (uint32_t first = 0; first < blocks_y; first += band)
+		{
+			const uint32_t last = std::min(first + band, blocks_y);
+			pool->push([=]()
+			{
+				uint8_t block[64];
+				for (uint32_t y = first; y < last; y++)
+				{
+					for (uint32_t x = 0; x < blocks_x; x++)
+					{
+						fetch_block(source, extent, x * 4, y * 4, block);
+						encode_block(block, format, content, destination + ((size_t)y * blocks_x + x) * block_bytes);
+					}
+				}
+			});
+		}
+	}
+	pool->wait();
+}
+
+bool SVL::TextureCompressor::load_cache(const std::string& path, Encoded& encoded) const
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	CacheHeader header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.magic != cache_magic || header.version != cache_version || header.format != (uint32_t)encoded.format
+		|| header.width != encoded.extent.width || header.height != encoded.extent.height || header.mip_levels != encoded.mip_levels
+		|| header.size != chain_size(encoded.extent, encoded.mip_levels, encoded.format))
+		return false;
+
+	encoded.data.resize((size_t)header.size);
+	file.read(reinterpret_cast<char*>(encoded.data.data()), header.size);
+	return !!file;
+}
+
+void SVL::TextureCompressor::save_cache(const std::string& path, const Encoded& encoded) const
+{
+	CacheHeader header{};
+	header.magic = cache_magic;
+	header.version = cache_version;
+	header.format = (uint32_t)encoded.format;
+	header.width = encoded.extent.width;
+	header.height = encoded.extent.height;
+	header.mip_levels = encoded.mip_levels;
+	header.size = encoded.data.size();
+
+	//written aside and moved over the entry in one step, readers see the old or the complete new entry
+	//a crash mid-write only leaves the .tmp file, which the next save overwrites
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(encoded.data.data()), encoded.data.size());
+		if (!file)
+		{
+			Log("SVL: can't write texture cache " + temporary + ".");
+			return;
+		}
+	}
+	if (!ReplaceFileAtomic(temporary, path))
+		Log("SVL: can't write texture cache " + path + ".");
+}
@@ -0,0 +1,66 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <SVL/definitions.h>
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace SVL
+{
+	class Renderer;
+	class UploadBatch;
+	class Texture;
+	class ThreadPool;
+
+	//what a texture holds, picks its block compressed format
+	enum TextureContent
+	{
+		ColorTexture, //bc7, bc1 or bc3 when fast
+		NormalTexture, //bc5 of x and y, shaders rebuild z
+		MetalRoughTexture, //bc5 of roughness and metalness, swizzled back to g and b
+		OcclusionTexture, //bc4 of r
+		OcclusionMetalRoughTexture //packed occlusion, roughness and metalness, bc7 or bc1 when fast
+	};
+
+	//block compresses 8 bit rgba textures on the cpu at import, the full mip chain is built and encoded on a thread pool
+	//encoded chains are cached on disk by content, later imports of the same pixels skip the encoding
+	class DLLDIR TextureCompressor
+	{
+	public:
+		//cache_directory must exist, empty for no cache; fast trades bc7 for bc1 and bc3
+		TextureCompressor(const Renderer& renderer, std::string cache_directory = "", bool fast = false);
+		~TextureCompressor();
+
+		TextureCompressor(const TextureCompressor&) = delete;
+		TextureCompressor& operator=(const TextureCompressor&) = delete;
+		TextureCompressor(TextureCompressor&&) = delete;
+		TextureCompressor& operator=(TextureCompressor&&) = delete;
+
+		//nullptr when the device can't sample the format, callers upload the pixels uncompressed
+		Texture* create_texture(UploadBatch& upload, const uint8_t* pixels, VkExtent2D extent, TextureContent content);
+	private:
+		struct Encoded
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkExtent2D extent{};
+			uint32_t mip_levels = 0;
+			std::vector<uint8_t> data; //levels packed one after another
+		};
+
+		const class Renderer& vk_renderer;
+		const std::string cache_directory;
+		const bool fast;
+		ThreadPool* pool;
+
+		VkFormat format(const uint8_t* pixels, VkExtent2D extent, TextureContent content) const;
+		bool supported(VkFormat format) const;
+		void encode(const uint8_t* pixels, TextureContent content, Encoded& encoded);
+
+		bool load_cache(const std::string& path, Encoded& encoded) const;
+		void save_cache(const std::string& path, const Encoded& encoded) const;
+	};
+}
+
+#endif // !TEXTURE_COMPRESSOR_H